@@ -0,0 +1,69 @@
+#include "arena.h"
+
+#include <stdio.h>
+
+#include "macros.h"
+
+arena *arena_create(uint64_t capacity)
+{
+    arena *a;
+
+    a = malloc(sizeof(struct arena));
+    if (!a)
+    {
+        perror("malloc");
+        return NULL;
+    }
+
+    a->used = 0;
+    a->capacity = arena_round(capacity);
+    a->base = malloc(a->capacity);
+    if (!a->base)
+    {
+        perror("malloc");
+        free(a);
+        return NULL;
+    }
+
+    return a;
+}
+
+/* growing moves the arena, so callers must hold offsets rather than pointers across calls */
+inline void *arena_alloc(arena *a, uint64_t size)
+{
+    uint64_t offset, capacity;
+    char *base;
+
+    size = arena_round(size);
+    if (unlikely(a->used + size > a->capacity))
+    {
+        capacity = a->capacity * 2;
+        while (capacity < a->used + size)
+        {
+            capacity *= 2;
+        }
+        base = realloc(a->base, capacity);
+        if (!base)
+        {
+            perror("realloc");
+            return NULL;
+        }
+        a->base = base;
+        a->capacity = capacity;
+    }
+
+    offset = a->used;
+    a->used += size;
+    return &a->base[offset];
+}
+
+inline void arena_clear(arena *a)
+{
+    a->used = 0;
+}
+
+void arena_destroy(arena *a)
+{
+    free(a->base);
+    free(a);
+}
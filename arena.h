@@ -0,0 +1,24 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#define ARENA_ALIGN 8
+#define arena_round(n) (((uint64_t)(n) + (ARENA_ALIGN - 1)) & ~((uint64_t)ARENA_ALIGN - 1))
+#define arenaat(a, offset) ((void *)&(a)->base[offset])
+
+/* bump allocator, memory is kept across arena_clear */
+typedef struct arena
+{
+    uint64_t used;
+    uint64_t capacity;
+    char *base;
+} arena;
+
+arena *arena_create(uint64_t capacity);
+void *arena_alloc(arena *a, uint64_t size);
+void arena_clear(arena *a);
+void arena_destroy(arena *a);
+
+#endif
@@ -17,7 +17,7 @@ inline void *array_init()
     a->size = 0;
     a->max_size = INITIAL_SIZE;
 
-    a->array = calloc(sizeof(void *), a->max_size);
+    a->array = malloc(sizeof(void *) * a->max_size);
     if (!a->array)
     {
         perror("malloc");
@@ -41,7 +41,7 @@ inline void *array_init_size(uint64_t init_size)
     a->size = 0;
     a->max_size = init_size;
 
-    a->array = calloc(sizeof(void *), a->max_size);
+    a->array = malloc(sizeof(void *) * a->max_size);
     if (!a->array)
     {
         perror("malloc");
@@ -51,15 +51,30 @@ inline void *array_init_size(uint64_t init_size)
     return a;
 }
 
-inline void array_add(array **a, void *element)
+/* false if the array could not grow, it is then left as it was */
+inline bool array_add(array **a, void *element)
 {
+    void **grown;
+
     if ((*a)->size == (*a)->max_size)
     {
-        (*a)->array = realloc((*a)->array, sizeof(void *) * (*a)->size * 2);
+        grown = realloc((*a)->array, sizeof(void *) * (*a)->size * 2);
+        if (!grown)
+        {
+            perror("realloc");
+            return false;
+        }
+        (*a)->array = grown;
         (*a)->max_size = (*a)->size * 2;
     }
     (*a)->array[(*a)->size] = element;
     (*a)->size += 1;
+    return true;
+}
+
+inline void array_clear(array *a)
+{
+    a->size = 0;
 }
 
 inline void *array_get(array *a, uint64_t index)
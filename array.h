@@ -1,6 +1,7 @@
 #ifndef ARRAY_H
 #define ARRAY_H
 
+#include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -18,7 +19,8 @@ typedef struct array
 void *array_init();
 void *array_init_size(uint64_t init_size);
 void array_destroy(array *a);
-void array_add(array **a, void *element);
+bool array_add(array **a, void *element);
+void array_clear(array *a);
 void *array_get(array *a, uint64_t index);
 void array_destroy(array *a);
 
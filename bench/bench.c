@@ -0,0 +1,380 @@
+/**
+ * Workload driver for the transactional memory library.
+ *
+ * Loads a build of the library through the tm.h API, runs each selected workload for a fixed
+ * duration at each thread count, checks the workload's invariants, and prints the results
+ * (throughput, abort rate, transaction latency percentiles) as one JSON document on stdout.
+ *
+ * Usage: bench [-w bank,list,...] [-t 1,2,4] [-d ms] [-u update%] [-n size] [-s seed] library.so
+ *
+ * The library runs in its default configuration unless TM_* variables are set in the environment,
+ * e.g. TM_IRREVOCABLE_AFTER=64 to run transactions alone after 64 aborts in a row.
+ **/
+
+#define _GNU_SOURCE
+#include <dlfcn.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "bench.h"
+
+#define DEFAULT_THREADS "1,2,4,8"
+#define DEFAULT_DURATION_MS 1000
+#define DEFAULT_UPDATE_PCT 20
+#define DEFAULT_SIZE 1024
+#define MAX_POINTS 64            /* thread counts in a sweep */
+#define LATENCY_SAMPLES (1 << 16) /* per thread, reservoir-sampled past that */
+
+tm_api tm;
+
+typedef struct worker
+{
+    pthread_t thread;
+    txn t;
+    workload const *workload;
+    bench_params const *params;
+    uint64_t commits;
+    uint64_t *latencies; /* nanoseconds */
+    uint64_t n_latencies;
+} worker;
+
+static atomic_bool running;
+static atomic_ulong ready; /* workers waiting for the start */
+static atomic_bool started;
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + (uint64_t)ts.tv_nsec;
+}
+
+static bool load_library(char const *path)
+{
+    void *handle = dlopen(path, RTLD_NOW | RTLD_LOCAL);
+    size_t (*stats_size)(void);
+
+    if (!handle)
+    {
+        fprintf(stderr, "bench: %s\n", dlerror());
+        return false;
+    }
+
+#define resolve(member, symbol)                                  \
+    if (!(*(void **)&tm.member = dlsym(handle, symbol)))         \
+    {                                                            \
+        fprintf(stderr, "bench: %s\n", dlerror());               \
+        return false;                                            \
+    }
+    resolve(create, "tm_create");
+    resolve(destroy, "tm_destroy");
+    resolve(start, "tm_start");
+    resolve(begin, "tm_begin");
+    resolve(end, "tm_end");
+    resolve(read, "tm_read");
+    resolve(write, "tm_write");
+    resolve(alloc, "tm_alloc");
+    resolve(free, "tm_free");
+#undef resolve
+
+    /* builds without statistics, or whose statistics no longer match bench.h, are still measured */
+    *(void **)&tm.stats = dlsym(handle, "tm_stats");
+    *(void **)&tm.abort_cause = dlsym(handle, "tm_abort_cause");
+    *(void **)&stats_size = dlsym(handle, "tm_stats_size");
+    if (!tm.abort_cause || !stats_size)
+    {
+        tm.stats = NULL;
+    }
+    else if (tm.stats && stats_size() != sizeof(tm_stats_t))
+    {
+        fprintf(stderr, "bench: %s has a %zu-byte tm_stats_t, bench.h %zu, stats left out\n", path, stats_size(),
+                sizeof(tm_stats_t));
+        tm.stats = NULL;
+    }
+    return true;
+}
+
+static void *worker_run(void *arg)
+{
+    worker *w = arg;
+    uint64_t begin, slot;
+
+    atomic_fetch_add(&ready, 1);
+    while (!atomic_load(&started))
+    {
+        sched_yield();
+    }
+    while (atomic_load_explicit(&running, memory_order_relaxed))
+    {
+        begin = now_ns();
+        w->workload->op(&w->t, w->params);
+        w->commits++;
+
+        /* keep a uniform sample of all latencies in a bounded buffer */
+        slot = w->commits <= LATENCY_SAMPLES ? w->commits - 1 : (uint64_t)rand_r(&w->t.seed) % w->commits;
+        if (slot < LATENCY_SAMPLES)
+        {
+            w->latencies[slot] = now_ns() - begin;
+        }
+    }
+    w->n_latencies = w->commits < LATENCY_SAMPLES ? w->commits : LATENCY_SAMPLES;
+    return NULL;
+}
+
+static int latency_cmp(void const *a, void const *b)
+{
+    uint64_t x = *(uint64_t const *)a, y = *(uint64_t const *)b;
+    return (x > y) - (x < y);
+}
+
+#define percentile(sorted, n, p) ((n) ? (sorted)[((n)-1) * (p) / 100] : 0)
+
+/* library counters over the measured interval, as the tail of a result object */
+static void print_stats(tm_stats_t const *before, tm_stats_t const *after)
+{
+    printf(", \"stats\": {\"reads\": %lu, \"writes\": %lu, \"max_reads\": %lu, \"max_writes\": %lu, "
+           "\"validations\": %lu, \"extensions\": %lu, \"irrevocable\": %lu, \"aborts\": {",
+           after->reads - before->reads, after->writes - before->writes, after->max_reads, after->max_writes,
+           after->validations - before->validations, after->extensions - before->extensions,
+           after->irrevocable - before->irrevocable);
+    for (int cause = ABORT_NONE + 1; cause < ABORT_CAUSES; cause++)
+    {
+        printf("%s\"%s\": %lu", cause == ABORT_NONE + 1 ? "" : ", ", tm.abort_cause(cause),
+               after->abort_causes[cause] - before->abort_causes[cause]);
+    }
+    printf("}}");
+}
+
+/** Run one workload at one thread count and print its result object.
+ * @return Whether the run could be set up, its invariants are reported in the result
+ **/
+static bool run_point(workload const *workload, bench_params const *params, uint64_t threads,
+                      uint64_t duration_ms, unsigned seed, bool first)
+{
+    worker *workers;
+    txn main_txn;
+    uint64_t begin, elapsed, commits = 0, aborts = 0, n_latencies = 0;
+    uint64_t *latencies;
+    struct timespec duration;
+    tm_stats_t before, after;
+    bool valid;
+    int error;
+
+    memset(&main_txn, 0, sizeof(main_txn));
+    main_txn.shared = tm.create(workload->region_size(params), sizeof(word));
+    if (main_txn.shared == invalid_shared)
+    {
+        fprintf(stderr, "bench: tm_create failed\n");
+        return false;
+    }
+    main_txn.start = tm.start(main_txn.shared);
+    main_txn.seed = seed;
+    workload->init(&main_txn, params);
+
+    workers = calloc(threads, sizeof(worker));
+    latencies = malloc(threads * LATENCY_SAMPLES * sizeof(uint64_t));
+    if (!workers || !latencies)
+    {
+        perror("malloc");
+        return false;
+    }
+
+    if (tm.stats)
+    {
+        tm.stats(main_txn.shared, &before);
+    }
+    atomic_store(&running, true);
+    atomic_store(&ready, 0);
+    atomic_store(&started, false);
+    for (uint64_t i = 0; i < threads; i++)
+    {
+        workers[i].t.shared = main_txn.shared;
+        workers[i].t.start = main_txn.start;
+        workers[i].t.seed = seed + (unsigned)i + 1;
+        workers[i].workload = workload;
+        workers[i].params = params;
+        workers[i].latencies = &latencies[i * LATENCY_SAMPLES];
+        error = pthread_create(&workers[i].thread, NULL, worker_run, &workers[i]);
+        if (error)
+        {
+            /* the workers already waiting start into a stopped run and return */
+            fprintf(stderr, "bench: %s with %lu threads: pthread_create: %s\n", workload->name, threads,
+                    strerror(error));
+            atomic_store(&running, false);
+            atomic_store(&started, true);
+            for (uint64_t j = 0; j < i; j++)
+            {
+                pthread_join(workers[j].thread, NULL);
+            }
+            tm.destroy(main_txn.shared);
+            free(latencies);
+            free(workers);
+            return false;
+        }
+    }
+
+    while (atomic_load(&ready) < threads)
+    {
+        sched_yield();
+    }
+    atomic_store(&started, true);
+    begin = now_ns();
+    duration.tv_sec = duration_ms / 1000;
+    duration.tv_nsec = (long)(duration_ms % 1000) * 1000000;
+    nanosleep(&duration, NULL);
+    atomic_store(&running, false);
+
+    valid = true;
+    for (uint64_t i = 0; i < threads; i++)
+    {
+        pthread_join(workers[i].thread, NULL);
+        commits += workers[i].commits;
+        aborts += workers[i].t.aborts;
+        valid = valid && !workers[i].t.invalid;
+
+        /* gather samples at the front of the buffer */
+        memmove(&latencies[n_latencies], workers[i].latencies, workers[i].n_latencies * sizeof(uint64_t));
+        n_latencies += workers[i].n_latencies;
+    }
+    elapsed = now_ns() - begin;
+    if (tm.stats)
+    {
+        tm.stats(main_txn.shared, &after);
+    }
+    valid = workload->check(&main_txn, params) && valid;
+    qsort(latencies, n_latencies, sizeof(uint64_t), latency_cmp);
+
+    printf("%s\n    {\"workload\": \"%s\", \"threads\": %lu, \"seconds\": %.3f, "
+           "\"commits\": %lu, \"aborts\": %lu, \"commits_per_s\": %.1f, \"abort_rate\": %.4f, "
+           "\"latency_ns\": {\"p50\": %lu, \"p90\": %lu, \"p99\": %lu, \"max\": %lu}, \"valid\": %s",
+           first ? "" : ",", workload->name, threads, elapsed / 1e9, commits, aborts,
+           commits / (elapsed / 1e9), commits + aborts ? (double)aborts / (commits + aborts) : 0.0,
+           percentile(latencies, n_latencies, 50), percentile(latencies, n_latencies, 90),
+           percentile(latencies, n_latencies, 99), n_latencies ? latencies[n_latencies - 1] : 0,
+           valid ? "true" : "false");
+    if (tm.stats)
+    {
+        print_stats(&before, &after);
+    }
+    printf("}");
+    fflush(stdout);
+
+    tm.destroy(main_txn.shared);
+    free(latencies);
+    free(workers);
+    return true;
+}
+
+/* whether name is an item of a comma-separated list */
+static bool listed(char const *list, char const *name)
+{
+    size_t length = strlen(name);
+    for (char const *item = list; item; item = strchr(item, ','), item = item ? item + 1 : NULL)
+    {
+        if (strncmp(item, name, length) == 0 && (item[length] == ',' || !item[length]))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+static void usage(char const *name)
+{
+    fprintf(stderr,
+            "usage: %s [-w workloads] [-t threads] [-d ms] [-u update%%] [-n size] [-s seed] library.so\n"
+            "  -w  comma-separated, among bank, list, hashset, rbtree, scan (default all)\n"
+            "  -t  comma-separated thread counts (default " DEFAULT_THREADS ")\n"
+            "  -d  duration of each run in milliseconds (default %d)\n"
+            "  -u  percentage of update transactions (default %d)\n"
+            "  -n  accounts, keys or words per run (default %d)\n"
+            "the library reads its TM_* variables from the environment, e.g. TM_IRREVOCABLE_AFTER=64\n"
+            "runs a transaction alone after 64 aborts in a row (default 0, never)\n",
+            name, DEFAULT_DURATION_MS, DEFAULT_UPDATE_PCT, DEFAULT_SIZE);
+}
+
+int main(int argc, char **argv)
+{
+    bench_params params = {DEFAULT_SIZE, DEFAULT_UPDATE_PCT};
+    uint64_t duration_ms = DEFAULT_DURATION_MS, threads[MAX_POINTS], n_threads = 0, irrevocable_after;
+    char const *selected = NULL;
+    char *list, *item, *save;
+    unsigned seed = 1;
+    bool first = true;
+    int opt;
+
+    list = strdup(DEFAULT_THREADS);
+    while ((opt = getopt(argc, argv, "w:t:d:u:n:s:h")) != -1)
+    {
+        switch (opt)
+        {
+        case 'w':
+            selected = optarg;
+            break;
+        case 't':
+            free(list);
+            list = strdup(optarg);
+            break;
+        case 'd':
+            duration_ms = strtoull(optarg, NULL, 10);
+            break;
+        case 'u':
+            params.update_pct = strtoull(optarg, NULL, 10);
+            break;
+        case 'n':
+            params.size = strtoull(optarg, NULL, 10);
+            break;
+        case 's':
+            seed = (unsigned)strtoul(optarg, NULL, 10);
+            break;
+        default:
+            usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    if (optind != argc - 1 || !params.size || params.update_pct > 100)
+    {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+    for (item = strtok_r(list, ",", &save); item && n_threads < MAX_POINTS; item = strtok_r(NULL, ",", &save))
+    {
+        threads[n_threads] = strtoull(item, NULL, 10);
+        n_threads += threads[n_threads] > 0;
+    }
+    free(list);
+    if (!load_library(argv[optind]))
+    {
+        return EXIT_FAILURE;
+    }
+
+    /* as tm_create reads it, unset means the library's default of 0 */
+    irrevocable_after = getenv("TM_IRREVOCABLE_AFTER") ? strtoull(getenv("TM_IRREVOCABLE_AFTER"), NULL, 0) : 0;
+    printf("{\"library\": \"%s\", \"duration_ms\": %lu, \"update_pct\": %lu, \"size\": %lu, \"seed\": %u,\n"
+           " \"irrevocable_after\": %lu,\n"
+           " \"results\": [",
+           argv[optind], duration_ms, params.update_pct, params.size, seed, irrevocable_after);
+    for (workload const *w = workloads; w->name; w++)
+    {
+        if (selected && !listed(selected, w->name))
+        {
+            continue;
+        }
+        for (uint64_t i = 0; i < n_threads; i++)
+        {
+            if (!run_point(w, &params, threads[i], duration_ms, seed, first))
+            {
+                return EXIT_FAILURE;
+            }
+            first = false;
+        }
+    }
+    printf("\n]}\n");
+    return EXIT_SUCCESS;
+}
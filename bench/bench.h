@@ -0,0 +1,138 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <setjmp.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "tm.h"
+
+/* types of the optional tm_stats() and tm_abort_cause(), as the library's internal stats.h declares them;
+ * stats are left out when the library's tm_stats_size() disagrees with sizeof(tm_stats_t) */
+
+typedef enum abort_cause
+{
+    ABORT_NONE,
+    ABORT_READ_CONFLICT,
+    ABORT_EXTEND,
+    ABORT_READ_ATTEMPTS,
+    ABORT_LOCK,
+    ABORT_VALIDATE_OUTDATED,
+    ABORT_VALIDATE_LOCKED,
+    ABORT_NOMEM,
+    ABORT_CAUSES,
+} abort_cause;
+
+typedef struct tm_stats_t
+{
+    uint64_t commits;
+    uint64_t ro_commits;
+    uint64_t aborts;
+    uint64_t abort_causes[ABORT_CAUSES];
+    uint64_t reads;
+    uint64_t writes;
+    uint64_t max_reads;
+    uint64_t max_writes;
+    uint64_t validations;
+    uint64_t extensions;
+    uint64_t irrevocable;
+} tm_stats_t;
+
+/* library entry points, resolved at run time so that builds can be compared side by side */
+typedef struct tm_api
+{
+    shared_t (*create)(size_t, size_t);
+    void (*destroy)(shared_t);
+    void *(*start)(shared_t);
+    tx_t (*begin)(shared_t, bool);
+    bool (*end)(shared_t, tx_t);
+    bool (*read)(shared_t, tx_t, void const *, size_t, void *);
+    bool (*write)(shared_t, tx_t, void const *, size_t, void *);
+    alloc_t (*alloc)(shared_t, tx_t, size_t, void **);
+    bool (*free)(shared_t, tx_t, void *);
+    void (*stats)(shared_t, tm_stats_t *);        /* optional, NULL if the build has no tm_stats */
+    char const *(*abort_cause)(abort_cause);      /* idem */
+} tm_api;
+
+extern tm_api tm;
+
+typedef struct bench_params
+{
+    uint64_t size;       /* accounts, keys or words, depending on the workload */
+    uint64_t update_pct; /* share of update transactions */
+} bench_params;
+
+/* per-thread transaction context, aborts restart at the last txn_begin() */
+typedef struct txn
+{
+    shared_t shared;
+    void *start; /* first word of the region */
+    tx_t tx;
+    jmp_buf restart;
+    uint64_t aborts;
+    unsigned seed;
+    bool invalid; /* an invariant failed inside a committed transaction */
+} txn;
+
+/* every access of a transaction is one shared word */
+typedef uint64_t word;
+
+/** Start a transaction, or start it over after an abort.
+ * Locals assigned between txn_begin() and txn_commit() must be reassigned on every attempt.
+ **/
+#define txn_begin(t, ro)                       \
+    do                                         \
+    {                                          \
+        if (setjmp((t)->restart))              \
+        {                                      \
+            (t)->aborts++;                     \
+        }                                      \
+        (t)->tx = tm.begin((t)->shared, (ro)); \
+    } while (0)
+
+#define txn_commit(t)                        \
+    do                                       \
+    {                                        \
+        if (!tm.end((t)->shared, (t)->tx))   \
+        {                                    \
+            longjmp((t)->restart, 1);        \
+        }                                    \
+    } while (0)
+
+static inline word txn_load(txn *t, word const *addr)
+{
+    word value;
+    if (!tm.read(t->shared, t->tx, addr, sizeof(word), &value))
+    {
+        longjmp(t->restart, 1);
+    }
+    return value;
+}
+
+static inline void txn_store(txn *t, word *addr, word value)
+{
+    if (!tm.write(t->shared, t->tx, &value, sizeof(word), addr))
+    {
+        longjmp(t->restart, 1);
+    }
+}
+
+void *txn_alloc(txn *t, size_t size);
+void txn_free(txn *t, void *addr);
+
+/* field f of the node at shared address p */
+#define field(p, f) (&((word *)(uintptr_t)(p))[f])
+
+typedef struct workload
+{
+    char const *name;
+    size_t (*region_size)(bench_params const *params); /* bytes of the first segment */
+    void (*init)(txn *t, bench_params const *params);  /* populate, single-threaded */
+    void (*op)(txn *t, bench_params const *params);    /* one transaction, retried until it commits */
+    bool (*check)(txn *t, bench_params const *params); /* structural invariants, single-threaded */
+} workload;
+
+extern workload const workloads[];
+
+#endif
@@ -0,0 +1,365 @@
+/**
+ * Microbenchmarks of the library's primitives.
+ *
+ * Linked against the library objects rather than the shared object, so that internal primitives
+ * (vlocks) can be timed directly and the clock can be bumped to force commit-time validation.
+ * Each benchmark reports wall time, and cycles, instructions and cache misses per operation
+ * when perf_event_open is available, as one JSON document on stdout.
+ *
+ * Usage: micro [-i iterations] [-n sizes]
+ **/
+
+#define _GNU_SOURCE
+#include <linux/perf_event.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "tm.h"
+
+#include "../region.h"
+#include "../sync.h"
+
+#define DEFAULT_ITERATIONS 1000000
+#define DEFAULT_SIZES "1,16,256"
+#define MAX_SIZES 16
+#define WORD sizeof(uint64_t)
+
+/* hardware counters read as one group */
+enum
+{
+    COUNTER_CYCLES,
+    COUNTER_INSTRUCTIONS,
+    COUNTER_CACHE_MISSES,
+    COUNTERS,
+};
+
+static int counter_fds[COUNTERS] = {-1, -1, -1};
+
+typedef struct measure
+{
+    uint64_t ns;
+    uint64_t counts[COUNTERS];
+    uint64_t started; /* ns timestamp while running */
+} measure;
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + (uint64_t)ts.tv_nsec;
+}
+
+/* open the counter group of the calling thread, leaving counters unavailable on failure */
+static void counters_open(void)
+{
+    static uint64_t const configs[COUNTERS] = {
+        [COUNTER_CYCLES] = PERF_COUNT_HW_CPU_CYCLES,
+        [COUNTER_INSTRUCTIONS] = PERF_COUNT_HW_INSTRUCTIONS,
+        [COUNTER_CACHE_MISSES] = PERF_COUNT_HW_CACHE_MISSES,
+    };
+    struct perf_event_attr attr;
+
+    for (int i = 0; i < COUNTERS; i++)
+    {
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.config = configs[i];
+        attr.disabled = i == 0;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.read_format = PERF_FORMAT_GROUP;
+        counter_fds[i] = (int)syscall(SYS_perf_event_open, &attr, 0, -1, i ? counter_fds[0] : -1, 0);
+        if (counter_fds[i] < 0)
+        {
+            for (int j = 0; j < i; j++)
+            {
+                close(counter_fds[j]);
+                counter_fds[j] = -1;
+            }
+            counter_fds[i] = -1;
+            return;
+        }
+    }
+}
+
+#define counters_available() (counter_fds[0] >= 0)
+
+static void measure_start(measure *m)
+{
+    memset(m, 0, sizeof(*m));
+}
+
+/* count from here until measure_pause(), accumulating across resumes */
+static void measure_resume(measure *m)
+{
+    if (counters_available())
+    {
+        ioctl(counter_fds[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+    }
+    m->started = now_ns();
+}
+
+static void measure_pause(measure *m)
+{
+    uint64_t values[1 + COUNTERS];
+
+    m->ns += now_ns() - m->started;
+    if (counters_available())
+    {
+        ioctl(counter_fds[0], PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+        if (read(counter_fds[0], values, sizeof(values)) == sizeof(values))
+        {
+            /* the group keeps counting from where it stopped, keep only the last total */
+            for (int i = 0; i < COUNTERS; i++)
+            {
+                m->counts[i] = values[1 + i];
+            }
+        }
+    }
+}
+
+static void measure_reset_counters(void)
+{
+    if (counters_available())
+    {
+        ioctl(counter_fds[0], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+    }
+}
+
+static bool first_result = true;
+
+static void report(char const *name, uint64_t n, uint64_t m, measure const *measure, uint64_t ops)
+{
+    printf("%s\n    {\"name\": \"%s\", \"n\": %lu, \"m\": %lu, \"ops\": %lu, \"ns_per_op\": %.2f", first_result ? "" : ",",
+           name, n, m, ops, (double)measure->ns / ops);
+    if (counters_available())
+    {
+        printf(", \"cycles_per_op\": %.2f, \"instructions_per_op\": %.2f, \"cache_misses_per_op\": %.4f",
+               (double)measure->counts[COUNTER_CYCLES] / ops, (double)measure->counts[COUNTER_INSTRUCTIONS] / ops,
+               (double)measure->counts[COUNTER_CACHE_MISSES] / ops);
+    }
+    else
+    {
+        printf(", \"cycles_per_op\": null, \"instructions_per_op\": null, \"cache_misses_per_op\": null");
+    }
+    printf("}");
+    fflush(stdout);
+    first_result = false;
+}
+
+/* Vlocks, uncontended */
+
+static void micro_vlocks(uint64_t iterations)
+{
+    vlock lock = 0;
+    uint64_t snapshot, src = 0, dest;
+    measure m;
+    bool old = true;
+
+    measure_start(&m);
+    measure_reset_counters();
+    measure_resume(&m);
+    for (uint64_t i = 0; i < iterations; i++)
+    {
+        vlock_try_acquire(&lock, &snapshot, 1);
+        vlock_release(&lock);
+    }
+    measure_pause(&m);
+    report("vlock_try_acquire+release", 0, 0, &m, iterations);
+
+    measure_start(&m);
+    measure_reset_counters();
+    measure_resume(&m);
+    for (uint64_t i = 0; i < iterations; i++)
+    {
+        old &= vlock_read(&lock, &src, &dest, sizeof(src), i);
+    }
+    measure_pause(&m);
+    report("vlock_read", 0, 0, &m, iterations);
+    if (!old)
+    {
+        fprintf(stderr, "micro: unexpected locked vlock\n");
+    }
+}
+
+/* Reads, per word, within one long transaction */
+
+static void micro_ro_read(shared_t shared, uint64_t iterations, uint64_t n)
+{
+    uint64_t *buffer = malloc(n * WORD);
+    measure m;
+    tx_t tx;
+
+    measure_start(&m);
+    measure_reset_counters();
+    tx = tm_begin(shared, true);
+    measure_resume(&m);
+    for (uint64_t i = 0; i < iterations / n + 1; i++)
+    {
+        tm_read(shared, tx, tm_start(shared), n * WORD, buffer);
+    }
+    measure_pause(&m);
+    tm_end(shared, tx);
+    report("ro_read", n, 0, &m, (iterations / n + 1) * n);
+    free(buffer);
+}
+
+/* one-word reads in a transaction that wrote n words, alternating hits and misses in its write set */
+static void micro_rw_read(shared_t shared, uint64_t iterations, uint64_t n)
+{
+    uint64_t value = 1, batch = 1024;
+    char *start = tm_start(shared);
+    measure m;
+    tx_t tx;
+
+    measure_start(&m);
+    measure_reset_counters();
+    for (uint64_t done = 0; done < iterations; done += batch)
+    {
+        tx = tm_begin(shared, false);
+        for (uint64_t i = 0; i < n; i++)
+        {
+            tm_write(shared, tx, &value, WORD, &start[2 * i * WORD]);
+        }
+        measure_resume(&m);
+        for (uint64_t i = 0; i < batch; i++)
+        {
+            tm_read(shared, tx, &start[(i % (2 * n)) * WORD], WORD, &value);
+        }
+        measure_pause(&m);
+        tm_end(shared, tx);
+    }
+    report("rw_read", n, 0, &m, (iterations + batch - 1) / batch * batch);
+}
+
+/* commit of a transaction that read n words and wrote m, with validation forced by a clock bump */
+static void micro_commit(shared_t shared, uint64_t iterations, uint64_t n, uint64_t m_writes)
+{
+    char *start = tm_start(shared);
+    uint64_t value;
+    measure m;
+    tx_t tx;
+
+    measure_start(&m);
+    measure_reset_counters();
+    for (uint64_t i = 0; i < iterations; i++)
+    {
+        tx = tm_begin(shared, false);
+        for (uint64_t j = 0; j < n; j++)
+        {
+            tm_read(shared, tx, &start[j * WORD], WORD, &value);
+        }
+        for (uint64_t j = 0; j < m_writes; j++)
+        {
+            tm_write(shared, tx, &value, WORD, &start[(n + j) * WORD]);
+        }
+        atomic_fetch_add(&((region *)shared)->clock, 1);
+        measure_resume(&m);
+        tm_end(shared, tx);
+        measure_pause(&m);
+    }
+    report("transaction_validate", n, m_writes, &m, iterations);
+}
+
+static void micro_alloc(shared_t shared, uint64_t iterations)
+{
+    void *segment;
+    measure m;
+    tx_t tx;
+
+    measure_start(&m);
+    measure_reset_counters();
+    measure_resume(&m);
+    for (uint64_t i = 0; i < iterations; i++)
+    {
+        tx = tm_begin(shared, false);
+        if (tm_alloc(shared, tx, 8 * WORD, &segment) == success_alloc)
+        {
+            tm_free(shared, tx, segment);
+        }
+        tm_end(shared, tx);
+    }
+    measure_pause(&m);
+    report("tm_alloc+tm_free", 0, 0, &m, iterations);
+}
+
+int main(int argc, char **argv)
+{
+    uint64_t iterations = DEFAULT_ITERATIONS, sizes[MAX_SIZES], n_sizes = 0, largest = 0, light;
+    char *list, *item, *save;
+    shared_t shared;
+    int opt;
+
+    list = strdup(DEFAULT_SIZES);
+    while ((opt = getopt(argc, argv, "i:n:h")) != -1)
+    {
+        switch (opt)
+        {
+        case 'i':
+            iterations = strtoull(optarg, NULL, 10);
+            break;
+        case 'n':
+            free(list);
+            list = strdup(optarg);
+            break;
+        default:
+            fprintf(stderr, "usage: %s [-i iterations] [-n comma-separated set sizes, default " DEFAULT_SIZES "]\n",
+                    argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    for (item = strtok_r(list, ",", &save); item && n_sizes < MAX_SIZES; item = strtok_r(NULL, ",", &save))
+    {
+        sizes[n_sizes] = strtoull(item, NULL, 10);
+        if (sizes[n_sizes] > largest)
+        {
+            largest = sizes[n_sizes];
+        }
+        n_sizes += sizes[n_sizes] > 0;
+    }
+    free(list);
+    if (!iterations || !n_sizes)
+    {
+        return EXIT_FAILURE;
+    }
+
+    /* room for the largest read set followed by the largest write set */
+    shared = tm_create(2 * largest * WORD, WORD);
+    if (shared == invalid_shared)
+    {
+        return EXIT_FAILURE;
+    }
+
+    counters_open();
+    printf("{\"iterations\": %lu, \"perf\": %s,\n \"results\": [", iterations, counters_available() ? "true" : "false");
+    micro_vlocks(iterations);
+    for (uint64_t i = 0; i < n_sizes; i++)
+    {
+        micro_ro_read(shared, iterations, sizes[i]);
+    }
+    for (uint64_t i = 0; i < n_sizes; i++)
+    {
+        micro_rw_read(shared, iterations, sizes[i]);
+    }
+
+    /* commits cost far more than single primitives */
+    light = iterations / 100 ? iterations / 100 : 1;
+    for (uint64_t i = 0; i < n_sizes; i++)
+    {
+        for (uint64_t j = 0; j < n_sizes; j++)
+        {
+            micro_commit(shared, light, sizes[i], sizes[j]);
+        }
+    }
+    micro_alloc(shared, light);
+    printf("\n]}\n");
+
+    tm_destroy(shared);
+    return EXIT_SUCCESS;
+}
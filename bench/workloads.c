@@ -0,0 +1,624 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "bench.h"
+
+#define INITIAL_BALANCE 100
+#define SCAN_CHUNK 512  /* words per tm_read of a scan */
+#define BUCKET_LOAD 4   /* keys per hash set bucket on average */
+
+/* keys are drawn from [0, 2 * size), so populated structures start half full */
+#define randkey(t, params) ((word)rand_r(&(t)->seed) % (2 * (params)->size))
+#define isupdate(t, params) ((uint64_t)rand_r(&(t)->seed) % 100 < (params)->update_pct)
+
+void *txn_alloc(txn *t, size_t size)
+{
+    void *addr;
+    switch (tm.alloc(t->shared, t->tx, size, &addr))
+    {
+    case success_alloc:
+        return addr;
+    case abort_alloc:
+        longjmp(t->restart, 1);
+    default:
+        fprintf(stderr, "bench: out of transactional memory\n");
+        exit(EXIT_FAILURE);
+    }
+}
+
+void txn_free(txn *t, void *addr)
+{
+    if (!tm.free(t->shared, t->tx, addr))
+    {
+        longjmp(t->restart, 1);
+    }
+}
+
+/* Bank: transfers between random accounts, read-only transactions query two balances */
+
+static size_t bank_region_size(bench_params const *params)
+{
+    return params->size * sizeof(word);
+}
+
+static void bank_init(txn *t, bench_params const *params)
+{
+    word *accounts = t->start;
+    txn_begin(t, false);
+    for (uint64_t i = 0; i < params->size; i++)
+    {
+        txn_store(t, &accounts[i], INITIAL_BALANCE);
+    }
+    txn_commit(t);
+}
+
+static void bank_transfer(txn *t, uint64_t from, uint64_t to)
+{
+    word *accounts = t->start;
+    txn_begin(t, false);
+    txn_store(t, &accounts[from], txn_load(t, &accounts[from]) - 1);
+    txn_store(t, &accounts[to], txn_load(t, &accounts[to]) + 1);
+    txn_commit(t);
+}
+
+static void bank_op(txn *t, bench_params const *params)
+{
+    word *accounts = t->start;
+    uint64_t a = (uint64_t)rand_r(&t->seed) % params->size;
+    uint64_t b = (uint64_t)rand_r(&t->seed) % params->size;
+
+    if (isupdate(t, params))
+    {
+        bank_transfer(t, a, b);
+        return;
+    }
+    txn_begin(t, true);
+    txn_load(t, &accounts[a]);
+    txn_load(t, &accounts[b]);
+    txn_commit(t);
+}
+
+/* sum of all accounts, read in chunks within one read-only transaction */
+static word bank_total(txn *t, bench_params const *params)
+{
+    word chunk[SCAN_CHUNK], total;
+    uint64_t n;
+
+    txn_begin(t, true);
+    total = 0;
+    for (uint64_t i = 0; i < params->size; i += n)
+    {
+        n = params->size - i < SCAN_CHUNK ? params->size - i : SCAN_CHUNK;
+        if (!tm.read(t->shared, t->tx, &((word *)t->start)[i], n * sizeof(word), chunk))
+        {
+            longjmp(t->restart, 1);
+        }
+        for (uint64_t j = 0; j < n; j++)
+        {
+            total += chunk[j];
+        }
+    }
+    txn_commit(t);
+    return total;
+}
+
+static bool bank_check(txn *t, bench_params const *params)
+{
+    return bank_total(t, params) == params->size * INITIAL_BALANCE;
+}
+
+/* Scan: read-only transactions sum the whole region, updates are bank transfers */
+
+static void scan_op(txn *t, bench_params const *params)
+{
+    if (isupdate(t, params))
+    {
+        bank_transfer(t, (uint64_t)rand_r(&t->seed) % params->size, (uint64_t)rand_r(&t->seed) % params->size);
+        return;
+    }
+    /* an inconsistent snapshot would show up as a wrong total */
+    if (bank_total(t, params) != params->size * INITIAL_BALANCE)
+    {
+        t->invalid = true;
+    }
+}
+
+/* Sorted linked list, also the bucket chains of the hash set */
+
+enum
+{
+    LIST_KEY,
+    LIST_NEXT,
+    LIST_WORDS,
+};
+
+/* link pointing to the first node whose key is not below key */
+static word *list_find(txn *t, word *head, word key, word *node)
+{
+    word *link = head;
+    *node = txn_load(t, link);
+    while (*node && txn_load(t, field(*node, LIST_KEY)) < key)
+    {
+        link = field(*node, LIST_NEXT);
+        *node = txn_load(t, link);
+    }
+    return link;
+}
+
+static void list_insert(txn *t, word *head, word key)
+{
+    word *link, node, added;
+
+    txn_begin(t, false);
+    link = list_find(t, head, key, &node);
+    if (!node || txn_load(t, field(node, LIST_KEY)) != key)
+    {
+        added = (word)(uintptr_t)txn_alloc(t, LIST_WORDS * sizeof(word));
+        txn_store(t, field(added, LIST_KEY), key);
+        txn_store(t, field(added, LIST_NEXT), node);
+        txn_store(t, link, added);
+    }
+    txn_commit(t);
+}
+
+static void list_remove(txn *t, word *head, word key)
+{
+    word *link, node;
+
+    txn_begin(t, false);
+    link = list_find(t, head, key, &node);
+    if (node && txn_load(t, field(node, LIST_KEY)) == key)
+    {
+        txn_store(t, link, txn_load(t, field(node, LIST_NEXT)));
+        txn_free(t, (void *)(uintptr_t)node);
+    }
+    txn_commit(t);
+}
+
+static void list_contains(txn *t, word *head, word key)
+{
+    word node;
+
+    txn_begin(t, true);
+    list_find(t, head, key, &node);
+    if (node)
+    {
+        txn_load(t, field(node, LIST_KEY));
+    }
+    txn_commit(t);
+}
+
+static void list_op_on(txn *t, bench_params const *params, word *head, word key)
+{
+    if (!isupdate(t, params))
+    {
+        list_contains(t, head, key);
+    }
+    else if (rand_r(&t->seed) & 1)
+    {
+        list_insert(t, head, key);
+    }
+    else
+    {
+        list_remove(t, head, key);
+    }
+}
+
+/* keys strictly increasing, each hashing to the chain's bucket */
+static bool list_valid(txn *t, word *head, uint64_t bucket, uint64_t buckets)
+{
+    word node, key, previous;
+    bool valid, first;
+
+    txn_begin(t, true);
+    valid = true;
+    first = true;
+    previous = 0;
+    for (node = txn_load(t, head); node; node = txn_load(t, field(node, LIST_NEXT)))
+    {
+        key = txn_load(t, field(node, LIST_KEY));
+        if ((!first && key <= previous) || key % buckets != bucket)
+        {
+            valid = false;
+        }
+        previous = key;
+        first = false;
+    }
+    txn_commit(t);
+    return valid;
+}
+
+/* a single word, the head or root pointer */
+static size_t root_region_size(bench_params const *unused)
+{
+    (void)unused;
+    return sizeof(word);
+}
+
+static void list_init(txn *t, bench_params const *params)
+{
+    for (uint64_t i = 0; i < params->size; i++)
+    {
+        list_insert(t, t->start, randkey(t, params));
+    }
+}
+
+static void list_op(txn *t, bench_params const *params)
+{
+    list_op_on(t, params, t->start, randkey(t, params));
+}
+
+static bool list_check(txn *t, bench_params const *unused)
+{
+    (void)unused;
+    return list_valid(t, t->start, 0, 1);
+}
+
+/* Hash set: an array of sorted chains */
+
+#define buckets(params) ((params)->size / BUCKET_LOAD ? (params)->size / BUCKET_LOAD : 1)
+
+static size_t hash_region_size(bench_params const *params)
+{
+    return buckets(params) * sizeof(word);
+}
+
+static void hash_init(txn *t, bench_params const *params)
+{
+    word key;
+    for (uint64_t i = 0; i < params->size; i++)
+    {
+        key = randkey(t, params);
+        list_insert(t, &((word *)t->start)[key % buckets(params)], key);
+    }
+}
+
+static void hash_op(txn *t, bench_params const *params)
+{
+    word key = randkey(t, params);
+    list_op_on(t, params, &((word *)t->start)[key % buckets(params)], key);
+}
+
+static bool hash_check(txn *t, bench_params const *params)
+{
+    for (uint64_t i = 0; i < buckets(params); i++)
+    {
+        if (!list_valid(t, &((word *)t->start)[i], i, buckets(params)))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+/* Red-black tree, null children count as black */
+
+enum
+{
+    RB_KEY,
+    RB_LEFT,
+    RB_RIGHT,
+    RB_PARENT,
+    RB_COLOR,
+    RB_WORDS,
+};
+
+#define RB_BLACK 0
+#define RB_RED 1
+
+#define rbget(t, n, f) txn_load(t, field(n, f))
+#define rbset(t, n, f, v) txn_store(t, field(n, f), (word)(v))
+#define rbcolor(t, n) ((n) ? rbget(t, n, RB_COLOR) : RB_BLACK)
+
+/* rotate n with its child on side, side being RB_LEFT or RB_RIGHT */
+static void rb_rotate(txn *t, word *root, word n, int side)
+{
+    int other = side == RB_LEFT ? RB_RIGHT : RB_LEFT;
+    word child, inner, parent;
+
+    child = rbget(t, n, other);
+    inner = rbget(t, child, side);
+    parent = rbget(t, n, RB_PARENT);
+
+    rbset(t, n, other, inner);
+    if (inner)
+    {
+        rbset(t, inner, RB_PARENT, n);
+    }
+    rbset(t, child, RB_PARENT, parent);
+    if (!parent)
+    {
+        txn_store(t, root, child);
+    }
+    else if (rbget(t, parent, RB_LEFT) == n)
+    {
+        rbset(t, parent, RB_LEFT, child);
+    }
+    else
+    {
+        rbset(t, parent, RB_RIGHT, child);
+    }
+    rbset(t, child, side, n);
+    rbset(t, n, RB_PARENT, child);
+}
+
+static void rb_insert_fixup(txn *t, word *root, word n)
+{
+    word parent, grand, uncle;
+    int side, other;
+
+    while ((parent = rbget(t, n, RB_PARENT)) && rbget(t, parent, RB_COLOR) == RB_RED)
+    {
+        grand = rbget(t, parent, RB_PARENT);
+        side = rbget(t, grand, RB_LEFT) == parent ? RB_LEFT : RB_RIGHT;
+        other = side == RB_LEFT ? RB_RIGHT : RB_LEFT;
+        uncle = rbget(t, grand, other);
+        if (rbcolor(t, uncle) == RB_RED)
+        {
+            rbset(t, parent, RB_COLOR, RB_BLACK);
+            rbset(t, uncle, RB_COLOR, RB_BLACK);
+            rbset(t, grand, RB_COLOR, RB_RED);
+            n = grand;
+            continue;
+        }
+        if (rbget(t, parent, other) == n)
+        {
+            n = parent;
+            rb_rotate(t, root, n, side);
+            parent = rbget(t, n, RB_PARENT);
+        }
+        rbset(t, parent, RB_COLOR, RB_BLACK);
+        rbset(t, grand, RB_COLOR, RB_RED);
+        rb_rotate(t, root, grand, other);
+    }
+    rbset(t, txn_load(t, root), RB_COLOR, RB_BLACK);
+}
+
+static void rb_insert(txn *t, word *root, word key)
+{
+    word parent, n, k, added;
+
+    txn_begin(t, false);
+    parent = 0;
+    n = txn_load(t, root);
+    while (n)
+    {
+        k = rbget(t, n, RB_KEY);
+        if (k == key)
+        {
+            break;
+        }
+        parent = n;
+        n = rbget(t, n, key < k ? RB_LEFT : RB_RIGHT);
+    }
+    if (!n)
+    {
+        added = (word)(uintptr_t)txn_alloc(t, RB_WORDS * sizeof(word));
+        rbset(t, added, RB_KEY, key);
+        rbset(t, added, RB_PARENT, parent);
+        rbset(t, added, RB_COLOR, RB_RED);
+        if (!parent)
+        {
+            txn_store(t, root, added);
+        }
+        else
+        {
+            rbset(t, parent, key < rbget(t, parent, RB_KEY) ? RB_LEFT : RB_RIGHT, added);
+        }
+        rb_insert_fixup(t, root, added);
+    }
+    txn_commit(t);
+}
+
+/* put v in the place of u under u's parent */
+static void rb_transplant(txn *t, word *root, word u, word v)
+{
+    word parent = rbget(t, u, RB_PARENT);
+    if (!parent)
+    {
+        txn_store(t, root, v);
+    }
+    else if (rbget(t, parent, RB_LEFT) == u)
+    {
+        rbset(t, parent, RB_LEFT, v);
+    }
+    else
+    {
+        rbset(t, parent, RB_RIGHT, v);
+    }
+    if (v)
+    {
+        rbset(t, v, RB_PARENT, parent);
+    }
+}
+
+/* n, possibly null, carries an extra black and hangs under parent */
+static void rb_remove_fixup(txn *t, word *root, word n, word parent)
+{
+    word sibling;
+    int side, other;
+
+    while (n != txn_load(t, root) && rbcolor(t, n) == RB_BLACK)
+    {
+        side = rbget(t, parent, RB_LEFT) == n ? RB_LEFT : RB_RIGHT;
+        other = side == RB_LEFT ? RB_RIGHT : RB_LEFT;
+        sibling = rbget(t, parent, other);
+        if (rbcolor(t, sibling) == RB_RED)
+        {
+            rbset(t, sibling, RB_COLOR, RB_BLACK);
+            rbset(t, parent, RB_COLOR, RB_RED);
+            rb_rotate(t, root, parent, side);
+            sibling = rbget(t, parent, other);
+        }
+        if (rbcolor(t, rbget(t, sibling, RB_LEFT)) == RB_BLACK && rbcolor(t, rbget(t, sibling, RB_RIGHT)) == RB_BLACK)
+        {
+            rbset(t, sibling, RB_COLOR, RB_RED);
+            n = parent;
+            parent = rbget(t, n, RB_PARENT);
+            continue;
+        }
+        if (rbcolor(t, rbget(t, sibling, other)) == RB_BLACK)
+        {
+            rbset(t, rbget(t, sibling, side), RB_COLOR, RB_BLACK);
+            rbset(t, sibling, RB_COLOR, RB_RED);
+            rb_rotate(t, root, sibling, other);
+            sibling = rbget(t, parent, other);
+        }
+        rbset(t, sibling, RB_COLOR, rbget(t, parent, RB_COLOR));
+        rbset(t, parent, RB_COLOR, RB_BLACK);
+        rbset(t, rbget(t, sibling, other), RB_COLOR, RB_BLACK);
+        rb_rotate(t, root, parent, side);
+        n = txn_load(t, root);
+    }
+    if (n)
+    {
+        rbset(t, n, RB_COLOR, RB_BLACK);
+    }
+}
+
+static void rb_remove(txn *t, word *root, word key)
+{
+    word n, k, next, child, parent, color;
+
+    txn_begin(t, false);
+    n = txn_load(t, root);
+    while (n && (k = rbget(t, n, RB_KEY)) != key)
+    {
+        n = rbget(t, n, key < k ? RB_LEFT : RB_RIGHT);
+    }
+    if (n)
+    {
+        color = rbget(t, n, RB_COLOR);
+        if (!rbget(t, n, RB_LEFT) || !rbget(t, n, RB_RIGHT))
+        {
+            child = rbget(t, n, rbget(t, n, RB_LEFT) ? RB_LEFT : RB_RIGHT);
+            parent = rbget(t, n, RB_PARENT);
+            rb_transplant(t, root, n, child);
+        }
+        else
+        {
+            /* the successor takes the removed node's place and color */
+            next = rbget(t, n, RB_RIGHT);
+            while (rbget(t, next, RB_LEFT))
+            {
+                next = rbget(t, next, RB_LEFT);
+            }
+            color = rbget(t, next, RB_COLOR);
+            child = rbget(t, next, RB_RIGHT);
+            if (rbget(t, next, RB_PARENT) == n)
+            {
+                parent = next;
+            }
+            else
+            {
+                parent = rbget(t, next, RB_PARENT);
+                rb_transplant(t, root, next, child);
+                rbset(t, next, RB_RIGHT, rbget(t, n, RB_RIGHT));
+                rbset(t, rbget(t, next, RB_RIGHT), RB_PARENT, next);
+            }
+            rb_transplant(t, root, n, next);
+            rbset(t, next, RB_LEFT, rbget(t, n, RB_LEFT));
+            rbset(t, rbget(t, next, RB_LEFT), RB_PARENT, next);
+            rbset(t, next, RB_COLOR, rbget(t, n, RB_COLOR));
+        }
+        if (color == RB_BLACK)
+        {
+            rb_remove_fixup(t, root, child, parent);
+        }
+        txn_free(t, (void *)(uintptr_t)n);
+    }
+    txn_commit(t);
+}
+
+static void rb_lookup(txn *t, word *root, word key)
+{
+    word n, k;
+
+    txn_begin(t, true);
+    n = txn_load(t, root);
+    while (n && (k = rbget(t, n, RB_KEY)) != key)
+    {
+        n = rbget(t, n, key < k ? RB_LEFT : RB_RIGHT);
+    }
+    txn_commit(t);
+}
+
+/** Check ordering, parent links and colors of a subtree.
+ * @return Black height of the subtree, -1 if it is invalid
+ **/
+static int64_t rb_valid(txn *t, word n, word parent, word low, word high)
+{
+    int64_t left, right;
+    word key;
+
+    if (!n)
+    {
+        return 1;
+    }
+    key = rbget(t, n, RB_KEY);
+    if (key < low || key > high || rbget(t, n, RB_PARENT) != parent)
+    {
+        return -1;
+    }
+    if (rbget(t, n, RB_COLOR) == RB_RED &&
+        (rbcolor(t, rbget(t, n, RB_LEFT)) == RB_RED || rbcolor(t, rbget(t, n, RB_RIGHT)) == RB_RED))
+    {
+        return -1;
+    }
+    left = rb_valid(t, rbget(t, n, RB_LEFT), n, low, key ? key - 1 : 0);
+    right = rb_valid(t, rbget(t, n, RB_RIGHT), n, key + 1, high);
+    if (left < 0 || right < 0 || left != right || (!key && rbget(t, n, RB_LEFT)))
+    {
+        return -1;
+    }
+    return left + (rbget(t, n, RB_COLOR) == RB_BLACK);
+}
+
+static void rb_init(txn *t, bench_params const *params)
+{
+    for (uint64_t i = 0; i < params->size; i++)
+    {
+        rb_insert(t, t->start, randkey(t, params));
+    }
+}
+
+static void rb_op(txn *t, bench_params const *params)
+{
+    word key = randkey(t, params);
+    if (!isupdate(t, params))
+    {
+        rb_lookup(t, t->start, key);
+    }
+    else if (rand_r(&t->seed) & 1)
+    {
+        rb_insert(t, t->start, key);
+    }
+    else
+    {
+        rb_remove(t, t->start, key);
+    }
+}
+
+static bool rb_check(txn *t, bench_params const *unused)
+{
+    bool valid;
+    word root;
+
+    (void)unused;
+    txn_begin(t, true);
+    root = txn_load(t, t->start);
+    valid = rbcolor(t, root) == RB_BLACK && rb_valid(t, root, 0, 0, UINT64_MAX) > 0;
+    txn_commit(t);
+    return valid;
+}
+
+workload const workloads[] = {
+    {"bank", bank_region_size, bank_init, bank_op, bank_check},
+    {"list", root_region_size, list_init, list_op, list_check},
+    {"hashset", hash_region_size, hash_init, hash_op, hash_check},
+    {"rbtree", root_region_size, rb_init, rb_op, rb_check},
+    {"scan", bank_region_size, bank_init, scan_op, bank_check},
+    {NULL, NULL, NULL, NULL, NULL},
+};
@@ -0,0 +1,77 @@
+#include "clock.h"
+
+#include <stdatomic.h>
+
+#include "macros.h"
+
+static _Thread_local uint64_t clock_seed = 0;
+
+static inline uint64_t clock_random(void)
+{
+    /* xorshift64, seeded from the thread-local's address */
+    if (unlikely(!clock_seed))
+    {
+        clock_seed = (uint64_t)&clock_seed | 1;
+    }
+    clock_seed ^= clock_seed << 13;
+    clock_seed ^= clock_seed >> 7;
+    clock_seed ^= clock_seed << 17;
+    return clock_seed;
+}
+
+/** Pick the version a committing transaction publishes, called with its write set locked.
+ * @param timestamp Snapshot of the committing transaction
+ * @param validate  Set to whether the read set must be validated, i.e. whether another
+ *                  transaction may have committed since the snapshot
+ * @return Write version
+ **/
+uint64_t clock_commit(region *region, uint64_t timestamp, bool *validate)
+{
+    uint64_t clock;
+
+    switch (region->config.clock)
+    {
+    case CLOCK_GV4:
+        /* a failed CAS means someone else advanced the clock, share their version */
+        clock = atomic_load(&region->clock);
+        if (atomic_compare_exchange_strong(&region->clock, &clock, clock + 1))
+        {
+            *validate = clock != timestamp;
+            return clock + 1;
+        }
+        *validate = true;
+        return clock;
+
+    case CLOCK_GV6:
+        /* commits of the GV5 kind leave the clock alone, so an unchanged clock proves nothing */
+        *validate = true;
+        if (clock_random() % region->config.clock_period == 0)
+        {
+            return atomic_fetch_add(&region->clock, 1) + 1;
+        }
+        /* fall through */
+    case CLOCK_GV5:
+        /* do not write the clock, readers that see the version advance it */
+        *validate = true;
+        return atomic_load(&region->clock) + 1;
+
+    default:
+        clock = atomic_fetch_add(&region->clock, 1);
+        *validate = clock != timestamp;
+        return clock + 1;
+    }
+}
+
+/* a reader saw a version above its snapshot, with lazy clocks the clock may lag behind it */
+void clock_observe(region *region, uint64_t version)
+{
+    uint64_t clock;
+
+    if (region->config.clock != CLOCK_GV5 && region->config.clock != CLOCK_GV6)
+    {
+        return;
+    }
+    clock = atomic_load(&region->clock);
+    while (clock < version && !atomic_compare_exchange_weak(&region->clock, &clock, version))
+        ;
+}
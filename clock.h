@@ -0,0 +1,14 @@
+#ifndef CLOCK_H
+#define CLOCK_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "region.h"
+
+#define clock_read(region) atomic_load(&(region)->clock)
+
+uint64_t clock_commit(region *region, uint64_t timestamp, bool *validate);
+void clock_observe(region *region, uint64_t version);
+
+#endif
@@ -0,0 +1,116 @@
+#include "cm.h"
+
+#include <sched.h>
+#include <stdatomic.h>
+
+#include "clock.h"
+#include "macros.h"
+
+static _Thread_local uint64_t cm_seed = 0;
+
+static inline uint64_t cm_random(void)
+{
+    /* xorshift64, seeded from the thread-local's address */
+    if (unlikely(!cm_seed))
+    {
+        cm_seed = (uint64_t)&cm_seed | 1;
+    }
+    cm_seed ^= cm_seed << 13;
+    cm_seed ^= cm_seed >> 7;
+    cm_seed ^= cm_seed << 17;
+    return cm_seed;
+}
+
+static inline uint64_t cm_work(handler *handler)
+{
+    return handler->r_set->size + handler->w_index->size + 1;
+}
+
+/* spin for a bit, then give the core away */
+inline void cm_pause(uint64_t attempt)
+{
+    if (attempt < CM_SPIN_BEFORE_YIELD)
+    {
+        cpu_relax();
+    }
+    else
+    {
+        sched_yield();
+    }
+}
+
+void cm_begin(region *region, handler *handler)
+{
+    uint64_t shift, slots;
+
+    /* the first attempt of a transaction fixes its age for every retry, from the global clock, */
+    /* the slot breaks ties between transactions that began at the same clock value            */
+    if (handler->aborts == 0 &&
+        (region->config.cm == CM_GREEDY || region->config.cm == CM_TIMESTAMP))
+    {
+        atomic_store_explicit(&region->threads[handler->slot].priority,
+                              clock_read(region) * MAX_THREADS + handler->slot, memory_order_relaxed);
+    }
+
+    /* randomized exponential backoff before retrying an aborted transaction */
+    if (handler->aborts > 0 && region->config.backoff_max > 0)
+    {
+        shift = handler->aborts < region->config.backoff_max ? handler->aborts : region->config.backoff_max;
+        slots = cm_random() & (((uint64_t)1 << shift) - 1);
+        for (uint64_t i = 0; i < slots * CM_BACKOFF_UNIT; i++)
+        {
+            cpu_relax();
+        }
+    }
+}
+
+void cm_abort(region *region, handler *handler)
+{
+    handler->aborts += 1;
+    if (region->config.cm == CM_KARMA)
+    {
+        /* work done in aborted attempts carries over */
+        atomic_fetch_add_explicit(&region->threads[handler->slot].priority, cm_work(handler), memory_order_relaxed);
+    }
+}
+
+void cm_commit(region *region, handler *handler)
+{
+    handler->aborts = 0;
+    if (region->config.cm == CM_KARMA)
+    {
+        atomic_store_explicit(&region->threads[handler->slot].priority, 0, memory_order_relaxed);
+    }
+}
+
+/** Decide whether to keep waiting for a lock held by another transaction.
+ * Commit locks are acquired in address order, so waiting can never deadlock.
+ * @param owner   Thread slot of the transaction holding the lock
+ * @param attempt Number of times the caller already waited for this lock
+ * @return Whether to wait, otherwise the caller aborts
+ **/
+bool cm_wait(region *region, handler *handler, uint64_t owner, uint64_t attempt)
+{
+    uint64_t mine, theirs;
+
+    theirs = atomic_load_explicit(&region->threads[owner].priority, memory_order_relaxed);
+    mine = atomic_load_explicit(&region->threads[handler->slot].priority, memory_order_relaxed);
+
+    switch (region->config.cm)
+    {
+    case CM_KARMA:
+        /* the transaction that did more work, counting past attempts, wins */
+        return mine + cm_work(handler) + attempt > theirs && attempt < CM_MAX_WAIT;
+
+    case CM_GREEDY:
+        /* the older transaction waits as long as it takes, the younger gives up */
+        return mine < theirs && attempt < CM_MAX_WAIT;
+
+    case CM_TIMESTAMP:
+        /* the older transaction waits a bounded time, the younger gives up */
+        return mine < theirs && attempt < SPINLOCK_BOUND;
+
+    default:
+        return attempt < SPINLOCK_BOUND;
+    }
+}
@@ -0,0 +1,20 @@
+#ifndef CM_H
+#define CM_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "handler.h"
+#include "region.h"
+
+#define CM_SPIN_BEFORE_YIELD 64 /* pauses before a waiting thread starts yielding */
+#define CM_BACKOFF_UNIT 32      /* pauses per backoff slot */
+#define CM_MAX_WAIT (1 << 20)   /* waits before even a winning transaction gives up */
+
+void cm_begin(region *region, handler *handler);
+void cm_abort(region *region, handler *handler);
+void cm_commit(region *region, handler *handler);
+bool cm_wait(region *region, handler *handler, uint64_t owner, uint64_t attempt);
+void cm_pause(uint64_t attempt);
+
+#endif
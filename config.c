@@ -0,0 +1,108 @@
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+static uint64_t log2_floor(uint64_t n)
+{
+    return n ? 63 - __builtin_clzll(n) : 0;
+}
+
+static uint64_t env_uint(const char *name, uint64_t fallback)
+{
+    const char *value = getenv(name);
+    char *end;
+    uint64_t n;
+
+    if (!value || !*value)
+    {
+        return fallback;
+    }
+    n = strtoull(value, &end, 0);
+    if (*end)
+    {
+        fprintf(stderr, "warning: ignoring invalid %s=%s\n", name, value);
+        return fallback;
+    }
+    return n;
+}
+
+static int env_choice(const char *name, const char *const *choices, int fallback)
+{
+    const char *value = getenv(name);
+
+    if (!value || !*value)
+    {
+        return fallback;
+    }
+    for (int i = 0; choices[i]; i++)
+    {
+        if (strcmp(value, choices[i]) == 0)
+        {
+            return i;
+        }
+    }
+    fprintf(stderr, "warning: ignoring invalid %s=%s\n", name, value);
+    return fallback;
+}
+
+void config_load(config *config, size_t align)
+{
+    static const char *const vlock_modes[] = {"word", "striped", "interleaved", NULL};
+    static const char *const clock_policies[] = {"gv1", "gv4", "gv5", "gv6", NULL};
+    static const char *const cm_policies[] = {"backoff", "karma", "greedy", "timestamp", NULL};
+    static const char *const hugepage_modes[] = {"off", "thp", "hugetlb", NULL};
+    static const char *const prefault_modes[] = {"none", "populate", "touch", NULL};
+    long cpus;
+    uint64_t stripes, granularity, block_size;
+
+    config->vlocks = env_choice("TM_VLOCKS", vlock_modes, VLOCKS_WORD);
+
+    stripes = env_uint("TM_STRIPES", DEFAULT_STRIPES);
+    config->stripe_bits = stripes > 1 ? log2_floor(stripes) : 1;
+
+    granularity = env_uint("TM_STRIPE_GRANULARITY", align);
+    config->stripe_shift = log2_floor(granularity < align ? align : granularity);
+
+    /* a block holds at least one word, headers stay 8-byte aligned */
+    block_size = env_uint("TM_BLOCK_SIZE", DEFAULT_BLOCK_SIZE);
+    config->block_words = block_size > sizeof(uint64_t) + align ? (block_size - sizeof(uint64_t)) / align : 1;
+    config->block_stride = (sizeof(uint64_t) + config->block_words * align + 7) & ~(uint64_t)7;
+
+    config->ro_extend = env_uint("TM_RO_EXTEND", DEFAULT_RO_EXTEND) != 0;
+    config->ro_log_bound = env_uint("TM_RO_LOG_BOUND", DEFAULT_RO_LOG_BOUND);
+    config->rw_extend = env_uint("TM_RW_EXTEND", DEFAULT_RW_EXTEND) != 0;
+
+    config->clock = env_choice("TM_CLOCK", clock_policies, CLOCK_GV1);
+    config->clock_period = env_uint("TM_CLOCK_PERIOD", DEFAULT_CLOCK_PERIOD);
+    if (!config->clock_period)
+    {
+        config->clock_period = 1;
+    }
+
+    config->cm = env_choice("TM_CM", cm_policies, CM_BACKOFF);
+    config->backoff_max = env_uint("TM_BACKOFF_MAX", DEFAULT_BACKOFF_MAX);
+
+    /* only per-word vlocks live in the segment, where they can be swapped */
+    config->adapt_words = config->vlocks == VLOCKS_WORD ? env_uint("TM_ADAPT_WORDS", DEFAULT_ADAPT_WORDS) : 0;
+    if (config->backoff_max > 32)
+    {
+        config->backoff_max = 32;
+    }
+
+    config->irrevocable_after = env_uint("TM_IRREVOCABLE_AFTER", DEFAULT_IRREVOCABLE_AFTER);
+    config->versions = env_uint("TM_VERSIONS", DEFAULT_VERSIONS);
+    config->profile_period = env_uint("TM_PROFILE_PERIOD", DEFAULT_PROFILE_PERIOD);
+
+    config->mmap_threshold = env_uint("TM_MMAP_THRESHOLD", DEFAULT_MMAP_THRESHOLD);
+    config->hugepages = env_choice("TM_HUGEPAGES", hugepage_modes, HUGEPAGES_THP);
+    config->prefault = env_choice("TM_PREFAULT", prefault_modes, PREFAULT_NONE);
+    cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    config->prefault_threads = env_uint("TM_PREFAULT_THREADS", cpus > 0 ? (uint64_t)cpus : 1);
+    if (!config->prefault_threads)
+    {
+        config->prefault_threads = 1;
+    }
+}
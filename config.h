@@ -0,0 +1,88 @@
+#ifndef CONFIG_H
+#define CONFIG_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define CACHE_LINE 64
+#define HUGE_PAGE_SIZE ((size_t)2 << 20)
+
+/* defaults, each can be overridden per region through the environment at tm_create */
+#define DEFAULT_STRIPES ((uint64_t)1 << 20) /* TM_STRIPES, power of 2 */
+#define DEFAULT_BLOCK_SIZE 64                /* TM_BLOCK_SIZE, bytes of version header + data */
+#define DEFAULT_RO_EXTEND 0                  /* TM_RO_EXTEND, read-only snapshot extension */
+#define DEFAULT_RO_LOG_BOUND 4096            /* TM_RO_LOG_BOUND, reads logged for extension */
+#define DEFAULT_RW_EXTEND 1                  /* TM_RW_EXTEND, read-write snapshot extension */
+#define DEFAULT_CLOCK_PERIOD 32              /* TM_CLOCK_PERIOD, commits per clock increment with GV6 */
+#define DEFAULT_BACKOFF_MAX 10               /* TM_BACKOFF_MAX, log2 of the largest backoff, 0 disables */
+#define DEFAULT_ADAPT_WORDS 0                /* TM_ADAPT_WORDS, accesses this long count as large, 0 disables */
+#define DEFAULT_IRREVOCABLE_AFTER 0          /* TM_IRREVOCABLE_AFTER, aborts in a row before running alone, 0 disables */
+#define DEFAULT_VERSIONS 0                   /* TM_VERSIONS, old values kept per word for read-only snapshots, 0 disables */
+#define DEFAULT_PROFILE_PERIOD 0             /* TM_PROFILE_PERIOD, one abort in this many is profiled, 0 disables */
+#define DEFAULT_MMAP_THRESHOLD HUGE_PAGE_SIZE /* TM_MMAP_THRESHOLD, bytes from which memory is mapped, 0 disables */
+
+typedef enum vlock_mode
+{
+    VLOCKS_WORD,    /* one vlock per aligned word, next to the segment (TM_VLOCKS=word) */
+    VLOCKS_STRIPED, /* region-wide table indexed by address hash (TM_VLOCKS=striped) */
+    VLOCKS_INTERLEAVED, /* one vlock header per block of words, inline with the data (TM_VLOCKS=interleaved) */
+} vlock_mode;
+
+typedef enum clock_policy
+{
+    CLOCK_GV1, /* every commit increments the clock (TM_CLOCK=gv1) */
+    CLOCK_GV4, /* one CAS, committers that lose it share the winner's version (TM_CLOCK=gv4) */
+    CLOCK_GV5, /* commits never write the clock, readers advance it (TM_CLOCK=gv5) */
+    CLOCK_GV6, /* GV5, with a GV1 increment on a random 1/TM_CLOCK_PERIOD of commits (TM_CLOCK=gv6) */
+} clock_policy;
+
+typedef enum cm_policy
+{
+    CM_BACKOFF,   /* wait a bounded time for a lock, then abort (TM_CM=backoff) */
+    CM_KARMA,     /* priority is the work done across aborted attempts (TM_CM=karma) */
+    CM_GREEDY,    /* the oldest transaction waits until the lock is free (TM_CM=greedy) */
+    CM_TIMESTAMP, /* the older transaction waits a bounded time, the younger aborts (TM_CM=timestamp) */
+} cm_policy;
+
+typedef enum hugepage_mode
+{
+    HUGEPAGES_OFF,     /* base pages (TM_HUGEPAGES=off) */
+    HUGEPAGES_THP,     /* ask for transparent huge pages (TM_HUGEPAGES=thp) */
+    HUGEPAGES_HUGETLB, /* reserved huge pages, transparent ones when none are left (TM_HUGEPAGES=hugetlb) */
+} hugepage_mode;
+
+typedef enum prefault_mode
+{
+    PREFAULT_NONE,     /* fault pages in on first access (TM_PREFAULT=none) */
+    PREFAULT_POPULATE, /* let the kernel fault them in at mapping (TM_PREFAULT=populate) */
+    PREFAULT_TOUCH,    /* write one byte per page from TM_PREFAULT_THREADS threads (TM_PREFAULT=touch) */
+} prefault_mode;
+
+typedef struct region_config
+{
+    vlock_mode vlocks;
+    uint64_t stripe_bits;  /* log2 of the number of stripes */
+    uint64_t stripe_shift; /* log2 of the bytes covered by one stripe, TM_STRIPE_GRANULARITY */
+    uint64_t block_words;  /* words following each header in an interleaved segment */
+    uint64_t block_stride; /* bytes from one header to the next */
+    bool ro_extend;        /* read-only transactions log reads so their snapshot can be extended */
+    uint64_t ro_log_bound; /* past this many reads, read-only transactions stop logging */
+    bool rw_extend;        /* read-write transactions revalidate and extend instead of aborting */
+    clock_policy clock;
+    uint64_t clock_period;
+    cm_policy cm;
+    uint64_t backoff_max; /* aborted transactions back off for up to 2^backoff_max slots */
+    uint64_t adapt_words; /* word segments mostly accessed this many words at a time get coarser vlocks */
+    uint64_t irrevocable_after; /* a transaction aborted this many times in a row runs alone */
+    uint64_t versions;          /* overwritten values kept per word, read-only transactions read them */
+    uint64_t profile_period;    /* aborts per conflict sample */
+    uint64_t mmap_threshold;    /* segment data and vlock tables this large are mapped rather than allocated */
+    hugepage_mode hugepages;
+    prefault_mode prefault;
+    uint64_t prefault_threads;
+} config;
+
+void config_load(config *config, size_t align);
+
+#endif
@@ -0,0 +1,127 @@
+#include "epoch.h"
+
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "macros.h"
+
+/* announce the global epoch, objects retired from now on outlive this transaction */
+inline void epoch_enter(region *region, handler *handler)
+{
+    atomic_store(&region->threads[handler->slot].epoch, atomic_load(&region->epoch));
+}
+
+inline void epoch_exit(region *region, handler *handler)
+{
+    atomic_store_explicit(&region->threads[handler->slot].epoch, EPOCH_QUIESCENT, memory_order_release);
+}
+
+/* the epoch can move on once every thread inside a transaction has seen it */
+static uint64_t epoch_advance(region *region)
+{
+    uint64_t epoch, announced, slots;
+
+    epoch = atomic_load(&region->epoch);
+    slots = handler_slots();
+    for (uint64_t i = 0; i < slots; i++)
+    {
+        announced = atomic_load(&region->threads[i].epoch);
+        if (announced != EPOCH_QUIESCENT && announced != epoch)
+        {
+            return epoch;
+        }
+    }
+    if (atomic_compare_exchange_strong(&region->epoch, &epoch, epoch + 1))
+    {
+        return epoch + 1;
+    }
+    return epoch;
+}
+
+/* reclaim the retired objects no transaction can still reach, they are in epoch order */
+static void epoch_reclaim(region *region, region_thread *thread, uint64_t epoch)
+{
+    uint64_t n = 0;
+
+    while (n < thread->limbo_size && thread->limbo[n].epoch + 2 <= epoch)
+    {
+        thread->limbo[n].reclaim(region, thread, thread->limbo[n].ptr);
+        n++;
+    }
+    if (n > 0)
+    {
+        memmove(thread->limbo, &thread->limbo[n], (thread->limbo_size - n) * sizeof(struct retired));
+        thread->limbo_size -= n;
+    }
+}
+
+/** Defer reclaiming an object until every transaction that may hold a reference to it has ended.
+ * @param ptr     Object no longer reachable by transactions starting from now on
+ * @param reclaim Called on the object once it is safe, by the retiring thread or by tm_destroy
+ **/
+void epoch_retire(region *region, handler *handler, void *ptr, reclaim_fn reclaim)
+{
+    region_thread *thread = &region->threads[handler->slot];
+    retired *limbo;
+    uint64_t max_size;
+
+    if (unlikely(thread->limbo_size == thread->limbo_max))
+    {
+        max_size = thread->limbo_max ? thread->limbo_max * 2 : EPOCH_BATCH * 2;
+        limbo = realloc(thread->limbo, sizeof(struct retired) * max_size);
+        if (!limbo)
+        {
+            /* leak rather than reclaim too early */
+            perror("realloc");
+            traceerror();
+            return;
+        }
+        thread->limbo = limbo;
+        thread->limbo_max = max_size;
+    }
+
+    thread->limbo[thread->limbo_size].ptr = ptr;
+    thread->limbo[thread->limbo_size].reclaim = reclaim;
+    thread->limbo[thread->limbo_size].epoch = atomic_load(&region->epoch);
+    thread->limbo_size += 1;
+
+    if (thread->limbo_size % EPOCH_BATCH == 0)
+    {
+        epoch_reclaim(region, thread, epoch_advance(region));
+    }
+}
+
+/** Reclaim what the calling thread retired, once every EPOCH_COLLECT_PERIOD calls while it has any.
+ * Called between transactions, so that threads retiring less than a batch get their objects back too.
+ **/
+void epoch_collect(region *region, handler *handler)
+{
+    region_thread *thread = &region->threads[handler->slot];
+
+    if (likely(!thread->limbo_size) || ++thread->limbo_collects % EPOCH_COLLECT_PERIOD)
+    {
+        return;
+    }
+    epoch_reclaim(region, thread, epoch_advance(region));
+}
+
+/* reclaim everything, with no running transaction */
+void epoch_drain(region *region)
+{
+    region_thread *thread;
+
+    for (uint64_t i = 0; i < handler_slots(); i++)
+    {
+        thread = &region->threads[i];
+        for (uint64_t n = 0; n < thread->limbo_size; n++)
+        {
+            thread->limbo[n].reclaim(region, thread, thread->limbo[n].ptr);
+        }
+        free(thread->limbo);
+        thread->limbo = NULL;
+        thread->limbo_size = 0;
+        thread->limbo_max = 0;
+    }
+}
@@ -0,0 +1,17 @@
+#ifndef EPOCH_H
+#define EPOCH_H
+
+#include "handler.h"
+#include "region.h"
+
+#define EPOCH_QUIESCENT 0       /* announced by threads outside a transaction */
+#define EPOCH_BATCH 64          /* retired objects a thread accumulates before reclaiming */
+#define EPOCH_COLLECT_PERIOD 16 /* transactions between two reclaims of a smaller limbo list */
+
+void epoch_enter(region *region, handler *handler);
+void epoch_exit(region *region, handler *handler);
+void epoch_retire(region *region, handler *handler, void *ptr, reclaim_fn reclaim);
+void epoch_collect(region *region, handler *handler);
+void epoch_drain(region *region);
+
+#endif
@@ -2,24 +2,140 @@
 
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include <strings.h>
 #include <stdatomic.h>
+#include <pthread.h>
 
 #include "macros.h"
 
-void handler_reset(handler *handler, bool preemptive)
+static pthread_key_t handler_key;
+static pthread_once_t handler_key_once = PTHREAD_ONCE_INIT;
+static _Thread_local handler *local_handler = NULL;
+static atomic_bool slots[MAX_THREADS];
+static atomic_ulong slots_high = 0; /* no slot at or above this was ever claimed */
+
+/* give the slot back and free the sets, some of which may be missing if creation failed */
+static void handler_destroy(void *h)
+{
+    handler *handler = h;
+    atomic_store(&slots[handler->slot], false);
+    if (handler->w_log)
+    {
+        arena_destroy(handler->w_log);
+    }
+    if (handler->w_index)
+    {
+        hashmap_destroy(handler->w_index);
+    }
+    if (handler->locks)
+    {
+        array_destroy(handler->locks);
+    }
+    if (handler->allocs)
+    {
+        array_destroy(handler->allocs);
+    }
+    if (handler->frees)
+    {
+        array_destroy(handler->frees);
+    }
+    if (handler->r_set)
+    {
+        array_destroy(handler->r_set);
+    }
+    free(handler);
+}
+
+static void handler_key_create(void)
+{
+    if (pthread_key_create(&handler_key, handler_destroy) != 0)
+    {
+        traceerror();
+    }
+}
+
+handler *handler_get(void)
 {
-    for (uint64_t i = 0; i < handler->w_set->size; i++)
+    handler *handler;
+
+    if (likely(local_handler))
+    {
+        return local_handler;
+    }
+
+    pthread_once(&handler_key_once, handler_key_create);
+
+    handler = malloc(sizeof(struct transaction_handler));
+    if (unlikely(!handler))
+    {
+        perror("malloc");
+        traceerror();
+        return NULL;
+    }
+
+    /* claim a free thread slot */
+    handler->slot = MAX_THREADS;
+    for (uint64_t i = 0; i < MAX_THREADS; i++)
     {
-        if (preemptive)
+        bool expected = false;
+        if (!atomic_load_explicit(&slots[i], memory_order_relaxed) &&
+            atomic_compare_exchange_strong(&slots[i], &expected, true))
         {
-            free(((write_entry *)arrayget(handler->w_set, i))->src);
+            handler->slot = i;
+            uint64_t high = atomic_load(&slots_high);
+            while (high <= i && !atomic_compare_exchange_weak(&slots_high, &high, i + 1))
+                ;
+            break;
         }
-        free(arrayget(handler->w_set, i));
     }
-    array_destroy(handler->w_set);
-    array_destroy(handler->r_set);
-    free(handler);
+    if (unlikely(handler->slot == MAX_THREADS))
+    {
+        fprintf(stderr, "warning: max threads %d exceeded\n", MAX_THREADS);
+        free(handler);
+        return NULL;
+    }
+    handler->aborts = 0;
+    handler->irrevocable = false;
+    handler->accesses = 0;
+    handler->conflict = NULL;
+    handler->conflicts = 0;
+
+    handler->r_set = array_init_size(INIT_RSET_SIZE);
+    handler->w_log = arena_create(INIT_WLOG_SIZE);
+    handler->w_index = hashmap_create(INIT_HASHMAP_SIZE);
+    handler->locks = array_init_size(INIT_WSET_SIZE);
+    handler->allocs = array_init_size(INIT_WSET_SIZE);
+    handler->frees = array_init_size(INIT_WSET_SIZE);
+    handler->r_overflow = false;
+    if (unlikely(!handler->r_set || !handler->w_log || !handler->w_index || !handler->locks ||
+                 !handler->allocs || !handler->frees))
+    {
+        traceerror();
+        handler_destroy(handler);
+        return NULL;
+    }
+
+    /* destroyed on thread exit */
+    pthread_setspecific(handler_key, handler);
+    local_handler = handler;
+    return handler;
+}
+
+void handler_reset(handler *handler)
+{
+    arena_clear(handler->w_log);
+    hashmap_clear(handler->w_index);
+    array_clear(handler->r_set);
+    array_clear(handler->allocs);
+    array_clear(handler->frees);
+    handler->r_overflow = false;
+    handler->conflict = NULL;
+}
+
+uint64_t handler_slots(void)
+{
+    return atomic_load(&slots_high);
 }
 
 inline void handler_add_read(handler *handler, read_entry r)
@@ -27,19 +143,71 @@ inline void handler_add_read(handler *handler, read_entry r)
     array_add(&handler->r_set, r);
 }
 
-inline int handler_add_write(handler *handler, void *src, void *dest, uint64_t size)
+/* value logged for a word, NULL if the transaction did not write it */
+inline void *handler_get_write(handler *handler, void const *dest)
 {
-    write_entry *e = malloc(sizeof(write_entry));
-    if (!e)
+    uint64_t offset;
+    if (!hashmap_get(handler->w_index, (uint64_t)dest, &offset))
     {
-        perror("malloc");
-        return -1;
+        return NULL;
     }
+    return arenaat(handler->w_log, offset);
+}
+
+/** Log a write of size bytes, word by word.
+ * A word right after the last record extends it, so contiguous writes end up as one record.
+ * @param align Word size, size is a multiple of it
+ * @return Whether the words could be logged
+ **/
+bool handler_add_write(handler *handler, void const *src, void *dest, uint64_t size, uint64_t align)
+{
+    write_entry *tail;
+    void *value;
+    uint64_t offset, extra;
 
-    e->size = size;
-    e->src = src;
-    e->dest = dest;
+    for (uint64_t i = 0; i < size; i += align)
+    {
+        /* a repeated write to the same word overwrites its value */
+        value = handler_get_write(handler, (char *)dest + i);
+        if (value)
+        {
+            memcpy(value, (char const *)src + i, align);
+            continue;
+        }
 
-    array_add(&handler->w_set, e);
-    return 0;
-}
\ No newline at end of file
+        tail = handler->w_log->used ? arenaat(handler->w_log, handler->w_tail) : NULL;
+        if (tail && (char *)tail->dest + tail->size == (char *)dest + i)
+        {
+            /* the tail record ends the log, growing the arena grows the record */
+            extra = wentry_length(tail->size + align) - wentry_length(tail->size);
+            if (extra && unlikely(!arena_alloc(handler->w_log, extra)))
+            {
+                traceerror();
+                return false;
+            }
+            tail = arenaat(handler->w_log, handler->w_tail);
+        }
+        else
+        {
+            handler->w_tail = handler->w_log->used;
+            tail = arena_alloc(handler->w_log, wentry_length(align));
+            if (unlikely(!tail))
+            {
+                traceerror();
+                return false;
+            }
+            tail->dest = (char *)dest + i;
+            tail->size = 0;
+        }
+
+        offset = handler->w_tail + sizeof(write_entry) + tail->size;
+        tail->size += align;
+        memcpy(arenaat(handler->w_log, offset), (char const *)src + i, align);
+        if (unlikely(!hashmap_put(handler->w_index, (uint64_t)dest + i, offset)))
+        {
+            traceerror();
+            return false;
+        }
+    }
+    return true;
+}
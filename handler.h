@@ -5,31 +5,55 @@
 #include <stdint.h>
 #include <stdatomic.h>
 
+#include "arena.h"
 #include "array.h"
+#include "hashmap.h"
 
 #define INIT_WSET_SIZE 3
+#define INIT_WLOG_SIZE 4096
 #define INIT_RSET_SIZE 2048
+#define MAX_THREADS 1024 /* concurrent threads with a descriptor, below VLOCK_MAX_OWNERS */
 
 typedef void *read_entry; /* opaque pointer */
 
+/* header of a redo log record, covering a run of contiguous words whose values follow inline */
 typedef struct write_entry
 {
-    void *src;  /* virtual address */
-    void *dest; /* opaque pointer */
-    uint64_t size;
+    void *dest;    /* opaque pointer to the first word */
+    uint64_t size; /* bytes, a multiple of the alignment */
+    char src[];
 } write_entry;
 
+#define wentry_length(size) (sizeof(write_entry) + arena_round(size))
+#define wlog_first(log) ((write_entry *)(log)->base)
+#define wlog_end(log) ((write_entry *)&(log)->base[(log)->used])
+#define wlog_next(e) ((write_entry *)((char *)(e) + wentry_length((e)->size)))
+
 typedef struct transaction_handler
 {
-    uint64_t id;
+    uint64_t slot;   /* thread slot, recorded as owner in the vlocks this thread holds */
+    uint64_t aborts; /* consecutive aborts since the last commit */
     bool is_ro;
+    bool irrevocable; /* holds the region's token, runs alone in place and never aborts */
+    bool r_overflow; /* read-only reads went unlogged, the snapshot can no longer be extended */
     uint64_t timestamp;
+    uint64_t accesses; /* reads and writes, one in ADAPT_PERIOD is sampled */
+    void const *conflict; /* opaque address of the word behind the last abort, NULL if unknown */
+    uint64_t conflicts;   /* aborts with a known word, one in config.profile_period is profiled */
     array *r_set;
-    array *w_set;
+    arena *w_log;
+    hashmap *w_index; /* opaque word address -> offset of its value in w_log */
+    uint64_t w_tail;  /* offset of the last record in w_log, extended by adjacent writes */
+    array *locks;     /* vlocks held during commit, sorted by address */
+    array *allocs;    /* segments allocated by the transaction, private until commit */
+    array *frees;     /* segments freed by the transaction, retired at commit */
 } handler;
 
-void handler_reset(handler *handler, bool preemptive);
+handler *handler_get(void);
+uint64_t handler_slots(void);
+void handler_reset(handler *handler);
 void handler_add_read(handler *handler, read_entry r);
-int handler_add_write(handler *handler, void *src, void *dest, uint64_t size);
+bool handler_add_write(handler *handler, void const *src, void *dest, uint64_t size, uint64_t align);
+void *handler_get_write(handler *handler, void const *dest);
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,133 @@
+#include "hashmap.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "macros.h"
+
+hashmap *hashmap_create(uint64_t init_size)
+{
+    hashmap *m;
+
+    m = malloc(sizeof(struct hashmap));
+    if (!m)
+    {
+        perror("malloc");
+        return NULL;
+    }
+
+    m->size = 0;
+    m->max_size = init_size;
+    m->epoch = 1;
+    m->bloom = 0;
+
+    m->entries = calloc(sizeof(struct hashmap_entry), m->max_size);
+    if (!m->entries)
+    {
+        perror("malloc");
+        free(m);
+        return NULL;
+    }
+
+    return m;
+}
+
+static inline hashmap_entry *hashmap_slot(hashmap *m, uint64_t key, uint64_t hash)
+{
+    uint64_t mask = m->max_size - 1;
+    hashmap_entry *e;
+
+    /* linear probing, the table is never more than half full */
+    for (uint64_t i = hash >> 32;; i++)
+    {
+        e = &m->entries[i & mask];
+        if (e->epoch != m->epoch || e->key == key)
+        {
+            return e;
+        }
+    }
+}
+
+static bool hashmap_grow(hashmap *m)
+{
+    hashmap_entry *old, *e;
+    uint64_t old_size;
+
+    old = m->entries;
+    old_size = m->max_size;
+
+    m->entries = calloc(sizeof(struct hashmap_entry), old_size * 2);
+    if (!m->entries)
+    {
+        perror("malloc");
+        m->entries = old;
+        return false;
+    }
+    m->max_size = old_size * 2;
+
+    for (uint64_t i = 0; i < old_size; i++)
+    {
+        if (old[i].epoch != m->epoch)
+        {
+            continue;
+        }
+        e = hashmap_slot(m, old[i].key, hashof(old[i].key));
+        *e = old[i];
+    }
+    free(old);
+    return true;
+}
+
+inline bool hashmap_get(hashmap *m, uint64_t key, uint64_t *value)
+{
+    uint64_t hash = hashof(key);
+    hashmap_entry *e;
+
+    if (!(m->bloom & bloombit(hash)))
+    {
+        return false;
+    }
+
+    e = hashmap_slot(m, key, hash);
+    if (e->epoch != m->epoch)
+    {
+        return false;
+    }
+    *value = e->value;
+    return true;
+}
+
+inline bool hashmap_put(hashmap *m, uint64_t key, uint64_t value)
+{
+    uint64_t hash = hashof(key);
+    hashmap_entry *e;
+
+    if (unlikely(2 * (m->size + 1) > m->max_size) && !hashmap_grow(m))
+    {
+        return false;
+    }
+
+    e = hashmap_slot(m, key, hash);
+    if (e->epoch != m->epoch)
+    {
+        e->epoch = m->epoch;
+        e->key = key;
+        m->size += 1;
+        m->bloom |= bloombit(hash);
+    }
+    e->value = value;
+    return true;
+}
+
+inline void hashmap_clear(hashmap *m)
+{
+    m->size = 0;
+    m->bloom = 0;
+    m->epoch += 1;
+}
+
+void hashmap_destroy(hashmap *m)
+{
+    free(m->entries);
+    free(m);
+}
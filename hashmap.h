@@ -0,0 +1,35 @@
+#ifndef HASHMAP_H
+#define HASHMAP_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define INIT_HASHMAP_SIZE 64 /* power of 2 */
+
+#define hashof(key) ((uint64_t)(key) * 0x9E3779B97F4A7C15ULL)
+#define bloombit(hash) ((uint64_t)1 << ((hash) >> 58))
+
+/* slots whose epoch differs from the map's are empty, so clearing is O(1) */
+typedef struct hashmap_entry
+{
+    uint64_t epoch;
+    uint64_t key;
+    uint64_t value;
+} hashmap_entry;
+
+typedef struct hashmap
+{
+    uint64_t size;
+    uint64_t max_size;
+    uint64_t epoch;
+    uint64_t bloom; /* one bit per inserted key, fast reject for lookups */
+    hashmap_entry *entries;
+} hashmap;
+
+hashmap *hashmap_create(uint64_t init_size);
+bool hashmap_get(hashmap *m, uint64_t key, uint64_t *value);
+bool hashmap_put(hashmap *m, uint64_t key, uint64_t value);
+void hashmap_clear(hashmap *m);
+void hashmap_destroy(hashmap *m);
+
+#endif
@@ -0,0 +1,245 @@
+#include "history.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "clock.h"
+#include "cm.h"
+#include "epoch.h"
+#include "macros.h"
+
+#define history_words(region, segment) ((segment)->capacity / (region)->alignment)
+
+/* give a chain of old values no reader can reach anymore back to the thread's pool, free it without one */
+static void history_reclaim(region *unused(region), region_thread *thread, void *ptr)
+{
+    version_node *node = ptr, *next;
+
+    for (; node; node = next)
+    {
+        next = atomic_load_explicit(&node->next, memory_order_relaxed);
+        if (thread && thread->history_spare < HISTORY_POOL_MAX)
+        {
+            atomic_store_explicit(&node->next, thread->history_pool, memory_order_relaxed);
+            thread->history_pool = node;
+            thread->history_spare++;
+        }
+        else
+        {
+            free(node);
+        }
+    }
+}
+
+/* one empty chain per word of the segment's size class, only with TM_VERSIONS */
+bool history_create(region *region, segment *segment)
+{
+    segment->history = NULL;
+    if (!region->config.versions)
+    {
+        return true;
+    }
+    segment->history = calloc(history_words(region, segment), sizeof(*segment->history));
+    if (unlikely(!segment->history))
+    {
+        perror("malloc");
+        return false;
+    }
+    return true;
+}
+
+/** Drop every old value, once no transaction can reach the segment.
+ * @param thread Slot state of the calling thread, whose pool takes the nodes back, or NULL to free them
+ **/
+void history_clear(region *region, region_thread *thread, segment *segment)
+{
+    if (!segment->history)
+    {
+        return;
+    }
+    for (uint64_t i = 0; i < history_words(region, segment); i++)
+    {
+        history_reclaim(region, thread, atomic_load_explicit(&segment->history[i], memory_order_relaxed));
+        atomic_store_explicit(&segment->history[i], NULL, memory_order_relaxed);
+    }
+}
+
+void history_destroy(region *region, segment *segment)
+{
+    history_clear(region, NULL, segment);
+    free(segment->history);
+}
+
+/* free the pools of every thread slot, with no running transaction */
+void history_drain(region *region)
+{
+    region_thread *thread;
+
+    for (uint64_t i = 0; i < handler_slots(); i++)
+    {
+        thread = &region->threads[i];
+        history_reclaim(region, NULL, thread->history_pool);
+        thread->history_pool = NULL;
+        thread->history_spare = 0;
+    }
+}
+
+/** Announce the snapshot of a read-only transaction, before taking it.
+ * The announced version is no newer than the snapshot, so old values it needs are kept.
+ **/
+void history_enter(region *region, handler *handler)
+{
+    atomic_store(&region->threads[handler->slot].snapshot, clock_read(region) + 1);
+}
+
+void history_exit(region *region, handler *handler)
+{
+    atomic_store_explicit(&region->threads[handler->slot].snapshot, 0, memory_order_release);
+}
+
+/* oldest snapshot a running or starting read-only transaction may read at */
+static uint64_t history_watermark(region *region)
+{
+    uint64_t watermark, announced, slots;
+
+    /* a snapshot announced after this load is taken after it too */
+    watermark = clock_read(region);
+    slots = handler_slots();
+    for (uint64_t i = 0; i < slots; i++)
+    {
+        announced = atomic_load(&region->threads[i].snapshot);
+        if (announced && announced - 1 < watermark)
+        {
+            watermark = announced - 1;
+        }
+    }
+    return watermark;
+}
+
+/** Fill the thread's pool with enough nodes for a commit, before it takes any lock.
+ * @param n Words the commit writes
+ * @return Whether the pool holds n nodes, the commit must abort otherwise
+ **/
+bool history_reserve(region *region, handler *handler, uint64_t n)
+{
+    region_thread *thread = &region->threads[handler->slot];
+    version_node *node;
+
+    while (thread->history_spare < n)
+    {
+        node = malloc(sizeof(version_node) + region->alignment);
+        if (unlikely(!node))
+        {
+            perror("malloc");
+            return false;
+        }
+        atomic_init(&node->next, thread->history_pool);
+        thread->history_pool = node;
+        thread->history_spare++;
+    }
+    return true;
+}
+
+/** Keep the values a commit is about to overwrite, called with the write set locked and validated.
+ * Nodes come from the pool filled by history_reserve, cut chains go back to it through the epochs.
+ * Chains keep at most config.versions values, and only those some snapshot may still read.
+ * @param version Write version of the commit
+ **/
+void history_record(region *region, handler *handler, uint64_t version)
+{
+    region_thread *thread = &region->threads[handler->slot];
+    segment *segment;
+    version_node *node, *prev, *next;
+    void *word;
+    uint64_t watermark, depth;
+
+    if (++thread->history_commits % HISTORY_WATERMARK_PERIOD == 0)
+    {
+        atomic_store_explicit(&region->watermark, history_watermark(region), memory_order_relaxed);
+    }
+    watermark = atomic_load_explicit(&region->watermark, memory_order_relaxed);
+
+    for (write_entry *write = wlog_first(handler->w_log); write < wlog_end(handler->w_log); write = wlog_next(write))
+    {
+        segment = region->segments[indexof(write->dest)];
+        for (uint64_t offset = 0; offset < write->size; offset += region->alignment)
+        {
+            word = (char *)write->dest + offset;
+            node = thread->history_pool;
+            thread->history_pool = atomic_load_explicit(&node->next, memory_order_relaxed);
+            thread->history_spare--;
+            node->from = getversion(atomic_load_explicit(getvlock(region, segment, word), memory_order_relaxed));
+            node->until = version;
+            memcpy(node->value, getword(region, segment, word), region->alignment);
+            atomic_init(&node->next, atomic_load_explicit(&segment->history[wordindex(region, segment, word)],
+                                                          memory_order_relaxed));
+
+            /* published before the new value, which is only visible once the vlock is released */
+            atomic_store_explicit(&segment->history[wordindex(region, segment, word)], node, memory_order_release);
+
+            /* the vlock makes this thread the chain's only writer, readers still on a cut tail hold an epoch */
+            depth = 1;
+            for (prev = node; (next = atomic_load_explicit(&prev->next, memory_order_relaxed)); prev = next, depth++)
+            {
+                if (depth >= region->config.versions || next->until <= watermark)
+                {
+                    atomic_store_explicit(&prev->next, NULL, memory_order_relaxed);
+                    epoch_retire(region, handler, next, history_reclaim);
+                    break;
+                }
+            }
+        }
+    }
+
+    /* lazy clocks would let snapshots taken after this commit read the values it overwrote */
+    clock_observe(region, version);
+}
+
+/** Read a word as of a snapshot, from memory if it has not changed since, from its history otherwise.
+ * @param word      Opaque address of the word
+ * @param timestamp Snapshot of the reading transaction
+ * @param old       Set to whether the value came from the history, and is no longer current
+ * @return Whether the value was found, false if too old to be kept or if its vlock cannot date it
+ **/
+bool history_read(region *region, segment *segment, void const *word, uint64_t timestamp, void *dest, bool *old)
+{
+    version_node *node;
+    uint64_t snapshot;
+
+    for (uint64_t attempt = 0; attempt < HISTORY_WAIT; attempt++)
+    {
+        snapshot = atomic_load(getvlock(region, segment, word));
+        if (unlocked(snapshot) && getversion(snapshot) <= timestamp)
+        {
+            memcpy(dest, getword(region, segment, word), region->alignment);
+            atomic_thread_fence(memory_order_acquire);
+            if (atomic_load(getvlock(region, segment, word)) == snapshot)
+            {
+                *old = false;
+                return true;
+            }
+            continue;
+        }
+
+        /* newest first, the first value overwritten after the snapshot was current at it */
+        for (node = atomic_load_explicit(&segment->history[wordindex(region, segment, word)], memory_order_acquire);
+             node && node->until > timestamp; node = atomic_load_explicit(&node->next, memory_order_acquire))
+        {
+            if (node->from <= timestamp)
+            {
+                memcpy(dest, node->value, region->alignment);
+                *old = true;
+                return true;
+            }
+        }
+
+        /* a locked word may be about to get the value this snapshot needs */
+        if (unlocked(snapshot))
+        {
+            return false;
+        }
+        cm_pause(attempt);
+    }
+    return false;
+}
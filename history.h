@@ -0,0 +1,34 @@
+#ifndef HISTORY_H
+#define HISTORY_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "handler.h"
+#include "region.h"
+
+#define HISTORY_WAIT 1024           /* pauses a reader waits for a committer to publish an old value */
+#define HISTORY_WATERMARK_PERIOD 64 /* commits per thread between two watermark updates */
+#define HISTORY_POOL_MAX 4096       /* spare nodes a thread keeps, reclaimed ones past that are freed */
+
+/* overwritten value of a word, with the versions it was current between */
+typedef struct version_node
+{
+    uint64_t from;  /* version of the word's vlock when overwritten, no older than the value */
+    uint64_t until; /* write version of the commit that overwrote it */
+    _Atomic(struct version_node *) next; /* older value */
+    char value[];
+} version_node;
+
+bool history_create(region *region, segment *segment);
+void history_clear(region *region, region_thread *thread, segment *segment);
+void history_destroy(region *region, segment *segment);
+void history_drain(region *region);
+void history_enter(region *region, handler *handler);
+void history_exit(region *region, handler *handler);
+bool history_reserve(region *region, handler *handler, uint64_t n);
+void history_record(region *region, handler *handler, uint64_t version);
+bool history_read(region *region, segment *segment, void const *word, uint64_t timestamp, void *dest, bool *old);
+
+#endif
@@ -35,6 +35,17 @@
 #warning This compiler has no support for GCC attributes
 #endif
 
+/** Hint to the CPU that the caller is spinning.
+ **/
+#undef cpu_relax
+#if defined(__x86_64__) || defined(__i386__)
+#define cpu_relax() __builtin_ia32_pause()
+#elif defined(__aarch64__)
+#define cpu_relax() __asm__ __volatile__("yield" ::: "memory")
+#else
+#define cpu_relax()
+#endif
+
 #define traceerror()                          \
     (fprintf(stderr, "%s: %s() at line %d\n", \
              __FILE__, __FUNCTION__, __LINE__))
@@ -0,0 +1,192 @@
+#define _GNU_SOURCE
+
+#include "memory.h"
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <strings.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "macros.h"
+
+#ifndef MAP_HUGE_SHIFT
+#define MAP_HUGE_SHIFT 26
+#endif
+#define MAP_HUGE_2MB (21 << MAP_HUGE_SHIFT)
+
+#define huge_round(bytes) (((bytes) + HUGE_PAGE_SIZE - 1) & ~(HUGE_PAGE_SIZE - 1))
+
+typedef struct touch_slice
+{
+    pthread_t thread;
+    volatile char *start;
+    size_t bytes;
+    bool threaded;
+} touch_slice;
+
+static void *touch_run(void *arg)
+{
+    touch_slice *slice = arg;
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+
+    for (size_t offset = 0; offset < slice->bytes; offset += page)
+    {
+        slice->start[offset] = 0;
+    }
+    return NULL;
+}
+
+/* fault a fresh mapping in, split in huge-page-aligned slices between threads */
+static void memory_touch(region *region, char *ptr, size_t bytes)
+{
+    uint64_t n_threads = bytes < PREFAULT_MIN_BYTES ? 1 : region->config.prefault_threads;
+    touch_slice *slices;
+    size_t slice_bytes;
+
+    slices = calloc(n_threads, sizeof(touch_slice));
+    if (unlikely(!slices))
+    {
+        touch_run(&(touch_slice){.start = ptr, .bytes = bytes});
+        return;
+    }
+    slice_bytes = huge_round((bytes + n_threads - 1) / n_threads);
+    for (uint64_t i = 0; i < n_threads && i * slice_bytes < bytes; i++)
+    {
+        slices[i].start = ptr + i * slice_bytes;
+        slices[i].bytes = bytes - i * slice_bytes < slice_bytes ? bytes - i * slice_bytes : slice_bytes;
+        slices[i].threaded = i > 0 && pthread_create(&slices[i].thread, NULL, touch_run, &slices[i]) == 0;
+        if (i > 0 && !slices[i].threaded)
+        {
+            touch_run(&slices[i]);
+        }
+    }
+    touch_run(&slices[0]);
+    for (uint64_t i = 1; i < n_threads; i++)
+    {
+        if (slices[i].threaded)
+        {
+            pthread_join(slices[i].thread, NULL);
+        }
+    }
+    free(slices);
+}
+
+/* map zeroed memory, on huge pages if possible, length a multiple of HUGE_PAGE_SIZE */
+static void *memory_map(region *region, size_t length)
+{
+    int prot = PROT_READ | PROT_WRITE, flags = MAP_PRIVATE | MAP_ANONYMOUS;
+    char *ptr, *aligned;
+
+    if (region->config.hugepages == HUGEPAGES_HUGETLB)
+    {
+        /* the pool is reserved at mapping, so this fails up front when it runs short */
+        ptr = mmap(NULL, length, prot,
+                   flags | MAP_HUGETLB | MAP_HUGE_2MB | (region->config.prefault == PREFAULT_POPULATE ? MAP_POPULATE : 0),
+                   -1, 0);
+        if (ptr != MAP_FAILED)
+        {
+            return ptr;
+        }
+    }
+
+    /* transparent huge pages only back ranges aligned on them, map one more to align the start */
+    ptr = mmap(NULL, length + HUGE_PAGE_SIZE, prot, flags, -1, 0);
+    if (unlikely(ptr == MAP_FAILED))
+    {
+        perror("mmap");
+        return NULL;
+    }
+    aligned = (char *)huge_round((uintptr_t)ptr);
+    if (aligned > ptr)
+    {
+        munmap(ptr, aligned - ptr);
+    }
+    munmap(aligned + length, ptr + HUGE_PAGE_SIZE - aligned);
+
+    /* best effort, transparent huge pages may be disabled system-wide */
+    if (region->config.hugepages != HUGEPAGES_OFF)
+    {
+        madvise(aligned, length, MADV_HUGEPAGE);
+    }
+    if (region->config.prefault == PREFAULT_POPULATE)
+    {
+#ifdef MADV_POPULATE_WRITE
+        if (madvise(aligned, length, MADV_POPULATE_WRITE) == 0)
+        {
+            return aligned;
+        }
+#endif
+        memory_touch(region, aligned, length);
+    }
+    return aligned;
+}
+
+/** Allocate zeroed memory for segment data or metadata.
+ * Blocks of at least config.mmap_threshold bytes are mapped, on huge pages and prefaulted as configured,
+ * smaller ones come from the heap.
+ * @param align Alignment of the block, a power of 2
+ * @return Block, NULL if out of memory
+ **/
+void *memory_alloc(region *region, size_t bytes, size_t align)
+{
+    void *ptr;
+
+    if (!memory_mapped(region, bytes, align))
+    {
+        ptr = aligned_alloc(align, (bytes + align - 1) & ~(align - 1));
+        if (unlikely(!ptr))
+        {
+            perror("malloc");
+            return NULL;
+        }
+        bzero(ptr, bytes);
+        return ptr;
+    }
+
+    ptr = memory_map(region, huge_round(bytes));
+    if (ptr && region->config.prefault == PREFAULT_TOUCH)
+    {
+        memory_touch(region, ptr, huge_round(bytes));
+    }
+    return ptr;
+}
+
+/* free a block of memory_alloc(), given the size and alignment it was allocated with */
+void memory_free(region *region, void *ptr, size_t bytes, size_t align)
+{
+    if (!ptr)
+    {
+        return;
+    }
+    if (memory_mapped(region, bytes, align))
+    {
+        munmap(ptr, huge_round(bytes));
+        return;
+    }
+    free(ptr);
+}
+
+/** Reserve a zeroed table sized for the worst case, whose pages are only backed once touched.
+ * @return Table, page aligned, NULL if out of address space
+ **/
+void *memory_reserve(size_t bytes)
+{
+    void *ptr = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (unlikely(ptr == MAP_FAILED))
+    {
+        perror("mmap");
+        return NULL;
+    }
+    return ptr;
+}
+
+void memory_unreserve(void *ptr, size_t bytes)
+{
+    if (ptr)
+    {
+        munmap(ptr, bytes);
+    }
+}
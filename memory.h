@@ -0,0 +1,20 @@
+#ifndef MEMORY_H
+#define MEMORY_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "region.h"
+
+#define PREFAULT_MIN_BYTES ((size_t)64 << 20) /* touched by one thread below this */
+
+/* whether a block of memory is mapped rather than allocated, fixed by its size and alignment */
+#define memory_mapped(region, bytes, align) \
+    ((region)->config.mmap_threshold && (bytes) >= (region)->config.mmap_threshold && (align) <= HUGE_PAGE_SIZE)
+
+void *memory_alloc(region *region, size_t bytes, size_t align);
+void memory_free(region *region, void *ptr, size_t bytes, size_t align);
+void *memory_reserve(size_t bytes);
+void memory_unreserve(void *ptr, size_t bytes);
+
+#endif
@@ -0,0 +1,208 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "profile.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "handler.h"
+#include "macros.h"
+#include "region.h"
+
+/* one word of the table, copied out for sorting */
+typedef struct profile_row
+{
+    uint64_t key;
+    uint64_t samples;
+    uint64_t causes[ABORT_CAUSES];
+} profile_row;
+
+profile *profile_create(void)
+{
+    char const *file = getenv("TM_PROFILE_FILE");
+    profile *profile;
+
+    profile = calloc(1, sizeof(struct profile));
+    if (unlikely(!profile))
+    {
+        perror("malloc");
+        traceerror();
+        return NULL;
+    }
+    profile->file = file && *file ? strdup(file) : NULL;
+    return profile;
+}
+
+/* write the table to TM_PROFILE_FILE if set, then free it */
+void profile_destroy(region *region)
+{
+    if (!region->profile)
+    {
+        return;
+    }
+    if (region->profile->file)
+    {
+        tm_profile_dump(region, region->profile->file, PROFILE_TOP);
+        free(region->profile->file);
+    }
+    free(region->profile);
+}
+
+/** Start a new generation of a segment index, whose conflicts are then counted apart from those of
+ * the segments previously allocated at the index.
+ * @param index Segment index being allocated, owned by the caller
+ * @return Generation to store in the segment, 0 if profiling is disabled
+ **/
+uint64_t profile_allocate(region *region, uint64_t index)
+{
+    return region->profile ? region->profile->generations[index]++ : 0;
+}
+
+/** Count an abort against the word that caused it, for one in config.profile_period of them.
+ * @param handler Aborting transaction, whose conflict field holds the word's opaque address
+ **/
+void profile_record(region *region, handler *handler, abort_cause cause)
+{
+    profile *profile = region->profile;
+    segment *segment;
+    uint64_t key, slot, expected;
+
+    if (++handler->conflicts % region->config.profile_period)
+    {
+        return;
+    }
+    segment = region->segments[indexof(handler->conflict)];
+    key = profile_key(segment->index, segment->generation, wordindex(region, segment, handler->conflict));
+    atomic_fetch_add_explicit(&profile->samples, 1, memory_order_relaxed);
+
+    /* open addressing, a slot is claimed once and keeps its word */
+    slot = hashof(key) >> 32;
+    for (uint64_t probe = 0; probe < PROFILE_PROBES; probe++, slot++)
+    {
+        profile_entry *entry = &profile->entries[slot & (PROFILE_SLOTS - 1)];
+        expected = atomic_load_explicit(&entry->key, memory_order_relaxed);
+        if (!expected && atomic_compare_exchange_strong(&entry->key, &expected, key))
+        {
+            expected = key;
+        }
+        if (expected == key)
+        {
+            atomic_fetch_add_explicit(&entry->causes[cause], 1, memory_order_relaxed);
+            return;
+        }
+    }
+    atomic_fetch_add_explicit(&profile->dropped, 1, memory_order_relaxed);
+}
+
+/* by segment, then hottest first */
+static int profile_row_cmp(void const *a, void const *b)
+{
+    profile_row const *x = a, *y = b;
+    if (profile_segment(x->key) != profile_segment(y->key))
+    {
+        return profile_segment(x->key) < profile_segment(y->key) ? -1 : 1;
+    }
+    return (x->samples < y->samples) - (x->samples > y->samples);
+}
+
+static void profile_print_row(FILE *file, region *region, profile_row const *row, bool first)
+{
+    bool first_cause = true;
+
+    fprintf(file, "%s\n      {\"offset\": %lu, \"samples\": %lu, \"causes\": {", first ? "" : ",",
+            profile_word(row->key) * region->alignment, row->samples);
+    for (int cause = ABORT_NONE + 1; cause < ABORT_CAUSES; cause++)
+    {
+        if (row->causes[cause])
+        {
+            fprintf(file, "%s\"%s\": %lu", first_cause ? "" : ", ", tm_abort_cause(cause), row->causes[cause]);
+            first_cause = false;
+        }
+    }
+    fprintf(file, "}}");
+}
+
+/** [thread-safe] Write the sampled conflicts as JSON, the hottest words of each segment first.
+ * Offsets are in bytes from the start of the segment. Segments are identified by their index and by
+ * their generation, which counts the allocations at that index before them.
+ * @param shared Shared memory region
+ * @param path   File to create or overwrite
+ * @param top    Words listed per segment
+ * @return Whether the table was written, false if profiling is disabled (TM_PROFILE_PERIOD=0)
+ **/
+bool tm_profile_dump(shared_t shared, char const *path, size_t top)
+{
+    region *region = shared;
+    profile *profile = region->profile;
+    profile_row *rows;
+    uint64_t n_rows = 0, key, first, total;
+    FILE *file;
+
+    if (!profile)
+    {
+        fprintf(stderr, "tm_profile_dump: profiling is disabled, set TM_PROFILE_PERIOD\n");
+        return false;
+    }
+    rows = malloc(sizeof(profile_row) * PROFILE_SLOTS);
+    if (unlikely(!rows))
+    {
+        perror("malloc");
+        traceerror();
+        return false;
+    }
+    for (uint64_t slot = 0; slot < PROFILE_SLOTS; slot++)
+    {
+        key = atomic_load_explicit(&profile->entries[slot].key, memory_order_relaxed);
+        if (!key)
+        {
+            continue;
+        }
+        rows[n_rows].key = key;
+        rows[n_rows].samples = 0;
+        for (int cause = 0; cause < ABORT_CAUSES; cause++)
+        {
+            rows[n_rows].causes[cause] = atomic_load_explicit(&profile->entries[slot].causes[cause],
+                                                              memory_order_relaxed);
+            rows[n_rows].samples += rows[n_rows].causes[cause];
+        }
+        n_rows++;
+    }
+    qsort(rows, n_rows, sizeof(profile_row), profile_row_cmp);
+
+    file = fopen(path, "w");
+    if (unlikely(!file))
+    {
+        perror("fopen");
+        traceerror();
+        free(rows);
+        return false;
+    }
+    fprintf(file, "{\"period\": %lu, \"samples\": %lu, \"dropped\": %lu, \"segments\": [", region->config.profile_period,
+            atomic_load(&profile->samples), atomic_load(&profile->dropped));
+    for (uint64_t i = 0; i < n_rows; i = first)
+    {
+        /* rows[i, first) belong to one segment */
+        total = 0;
+        for (first = i; first < n_rows && profile_segment(rows[first].key) == profile_segment(rows[i].key); first++)
+        {
+            total += rows[first].samples;
+        }
+        fprintf(file, "%s\n  {\"segment\": %lu, \"generation\": %lu, \"samples\": %lu, \"words\": %lu, \"hot\": [",
+                i ? "," : "", profile_index(rows[i].key), profile_generation(rows[i].key), total, first - i);
+        for (uint64_t j = i; j < first && j - i < top; j++)
+        {
+            profile_print_row(file, region, &rows[j], j == i);
+        }
+        fprintf(file, "]}");
+    }
+    fprintf(file, "\n]}\n");
+    free(rows);
+    if (unlikely(fclose(file) != 0))
+    {
+        perror("fclose");
+        traceerror();
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,51 @@
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "stats.h"
+#include "tm.h"
+
+#define PROFILE_SLOTS 4096 /* conflicting words tracked per region, power of 2 */
+#define PROFILE_PROBES 16  /* slots tried per word before the sample is dropped */
+#define PROFILE_TOP 16     /* words per segment in the dump written at tm_destroy */
+
+/* 16 bits of segment index, 16 of generation and 32 of word index, 0 marks a free slot.
+ * Generations wrap after 2^16 allocations at one index, words past 2^32 share a key. */
+#define profile_key(index, generation, word) \
+    (((uint64_t)(index) << 48 | (uint64_t)((generation) & 0xffff) << 32 | ((word) & 0xffffffff)) + 1)
+#define profile_index(key) (((key)-1) >> 48)
+#define profile_generation(key) ((((key)-1) >> 32) & 0xffff)
+#define profile_segment(key) (((key)-1) >> 32) /* index and generation */
+#define profile_word(key) (((key)-1) & 0xffffffff)
+
+/* aborts sampled on one word, keyed by segment index, generation and word index */
+typedef struct profile_entry
+{
+    atomic_ulong key;
+    atomic_ulong causes[ABORT_CAUSES];
+} profile_entry;
+
+/* lock-free table shared by the threads of a region */
+typedef struct profile
+{
+    atomic_ulong samples;
+    atomic_ulong dropped; /* samples that found no free slot */
+    char *file;           /* TM_PROFILE_FILE, written by tm_destroy, NULL if unset */
+    uint16_t generations[UINT16_MAX + 1]; /* allocations at each segment index so far, modulo 2^16 */
+    profile_entry entries[PROFILE_SLOTS];
+} profile;
+
+struct memory_region;
+struct transaction_handler;
+
+profile *profile_create(void);
+void profile_destroy(struct memory_region *region);
+uint64_t profile_allocate(struct memory_region *region, uint64_t index);
+void profile_record(struct memory_region *region, struct transaction_handler *handler, abort_cause cause);
+bool tm_profile_dump(shared_t shared, char const *path, size_t top);
+
+#endif
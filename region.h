@@ -4,11 +4,22 @@
 #include <stddef.h>
 #include <stdatomic.h>
 
+#include "config.h"
+#include "hashmap.h"
+#include "profile.h"
+#include "stats.h"
 #include "sync.h"
-#include "linked_list.h"
+#include "trace.h"
 
-#define MAX_SEGMENTS 1024 // hard limit 2^16
+#define MAX_SEGMENTS 65536 // hard limit 2^16
 #define RO_VALIDATE_ATTEMPTS 10
+#define BULK_CHUNK 64 /* vlocks loaded per copy of a multi-word read */
+#define POOL_CLASSES 15 /* size classes of the segment pool */
+
+#define SEGMENT_CACHE_SIZE 16 /* segments of aborted allocations kept per thread */
+
+#define SEGMENT_FREE 0
+#define SEGMENT_LIVE 1
 
 #define nbytemask(n) ((uint64_t)((((uint64_t)1) << (8 * n)) - 1))
 
@@ -29,26 +40,128 @@
 #define getsegment(segments, index) \
     ((segment *)arrayget(segments, index))
 
+/* vlocks of a VLOCKS_WORD segment, replaced by coarser ones when accesses are mostly large */
+typedef struct segment_meta
+{
+    uint64_t grain; /* log2 of the words guarded by each vlock, only ever grows */
+    uint64_t bytes; /* allocated, header included */
+    vlock vlocks[];
+} segment_meta;
+
 typedef struct memory_segment
 {
     uint64_t index;
-    uint64_t length;
+    uint64_t length;   /* words */
+    uint64_t capacity; /* bytes, the whole size class */
+    uint64_t class;    /* POOL_UNPOOLED if too large to be recycled */
+    atomic_uint state; /* SEGMENT_LIVE between tm_alloc and tm_free */
+    _Atomic(void *) owner; /* allocating transaction's handler until it commits, NULL once published */
     uint64_t vaddr_base;
-    void *vaddr;   /* heap */
-    vlock *vlocks; /* heap */
+    void *vaddr;   /* heap or mapped, data words or interleaved blocks */
+    size_t bytes;  /* allocated behind vaddr */
+    _Atomic(struct segment_meta *) meta; /* heap, only with VLOCKS_WORD */
+    atomic_ulong samples;                /* sampled accesses since the last decision */
+    atomic_ulong large;                  /* of which at least config.adapt_words long */
+    atomic_ulong min_large;              /* shortest of those, 0 if none */
+    atomic_bool coarsening;              /* a thread is switching the segment's vlocks */
+    _Atomic(struct version_node *) *history; /* heap, newest overwritten value of each word, only with TM_VERSIONS */
+    uint64_t generation;                     /* allocations at this index before this one, only with TM_PROFILE_PERIOD */
 } segment;
 
+struct memory_region;
+struct region_thread;
+typedef void (*reclaim_fn)(struct memory_region *region, struct region_thread *thread, void *ptr);
+
+typedef struct retired
+{
+    void *ptr;
+    reclaim_fn reclaim;
+    uint64_t epoch; /* global epoch when retired */
+} retired;
+
+/* per thread slot state of a region, cache-line aligned */
+typedef struct region_thread
+{
+    _Alignas(CACHE_LINE) atomic_ulong epoch; /* announced epoch, EPOCH_QUIESCENT outside transactions */
+    atomic_ulong snapshot;                   /* 1 + no newer than the read-only snapshot, 0 if none, with TM_VERSIONS */
+    atomic_ulong priority;                   /* contention manager's, read by transactions finding this slot's locks held */
+    uint64_t limbo_size;
+    uint64_t limbo_max;
+    struct retired *limbo; /* heap, only touched by the slot's thread */
+    uint64_t limbo_collects; /* transactions ended with a non-empty limbo list, modulo EPOCH_COLLECT_PERIOD */
+    uint64_t history_commits; /* commits since the watermark was last updated, modulo its period */
+    uint64_t history_spare;   /* nodes in history_pool */
+    struct version_node *history_pool; /* heap, nodes for history_record, linked through next */
+    uint64_t cache_size;
+    struct memory_segment *cache[SEGMENT_CACHE_SIZE]; /* freed by aborts, never published */
+    _Alignas(CACHE_LINE) thread_stats stats;          /* away from the epoch, which other threads scan */
+#ifdef TM_TRACE
+    _Atomic(struct trace_ring *) trace; /* heap, created by the slot's first traced event */
+#endif
+} region_thread;
+
 typedef struct memory_region
 {
     size_t alignment;
-    atomic_ulong clock;
-    atomic_ulong segment_count;
-    atomic_ulong next_segment;
-    atomic_ulong next_handler;        // TODO: remove
-    struct memory_segment **segments; /* heap */
-    lock segment_lock;
-    ll *alloced_list; /* heap */
-    ll *freed_list;   /* heap */
+    config config;
+    vlock *orecs; /* heap, only with VLOCKS_STRIPED */
+    struct memory_segment **segments; /* reserved, indexed by indexof() */
+    atomic_ushort *next_free;         /* reserved, links of the index stacks below */
+    region_thread *threads;           /* reserved, indexed by thread slot */
+    struct profile *profile;          /* heap, NULL unless TM_PROFILE_PERIOD is set */
+#ifdef TM_TRACE
+    trace_clock trace;
+#endif
+
+    /* counters written by different threads, one cache line each */
+    _Alignas(CACHE_LINE) atomic_ulong clock;
+    _Alignas(CACHE_LINE) atomic_ulong segment_count;
+    _Alignas(CACHE_LINE) atomic_ulong next_segment;
+    _Alignas(CACHE_LINE) atomic_ulong epoch;
+    _Alignas(CACHE_LINE) atomic_ulong irrevocable; /* slot + 1 of the transaction running alone, 0 if none */
+    _Alignas(CACHE_LINE) atomic_ulong watermark;   /* no snapshot older than this is running, with TM_VERSIONS */
+
+    /* lock-free stacks of segment indices linked through next_free, tagged against ABA */
+    _Alignas(CACHE_LINE) atomic_ulong free_indices; /* indices with no segment behind them */
+    _Alignas(CACHE_LINE) atomic_ulong pool[POOL_CLASSES];
+    atomic_ulong pool_size[POOL_CLASSES];
 } region;
 
+#define wordindex(region, segment, opaque) \
+    (((uint64_t)vaddrof(opaque, (segment)->vaddr_base) - (uint64_t)(segment)->vaddr) / (region)->alignment)
+
+#define blockof(region, segment, word) \
+    ((char *)(segment)->vaddr + ((word) / (region)->config.block_words) * (region)->config.block_stride)
+
+/* versioned lock guarding the word at an opaque address */
+static inline vlock *getvlock(region *region, segment *segment, void const *opaque)
+{
+    switch (region->config.vlocks)
+    {
+    case VLOCKS_STRIPED:
+        return &region->orecs[hashof((uint64_t)opaque >> region->config.stripe_shift) >>
+                              (64 - region->config.stripe_bits)];
+    case VLOCKS_INTERLEAVED:
+        return (vlock *)blockof(region, segment, wordindex(region, segment, opaque));
+    default:
+    {
+        segment_meta *meta = atomic_load_explicit(&segment->meta, memory_order_acquire);
+        return &meta->vlocks[wordindex(region, segment, opaque) >> meta->grain];
+    }
+    }
+}
+
+/* virtual address of the word at an opaque address */
+static inline void *getword(region *region, segment *segment, void const *opaque)
+{
+    uint64_t word;
+    if (region->config.vlocks == VLOCKS_INTERLEAVED)
+    {
+        word = wordindex(region, segment, opaque);
+        return blockof(region, segment, word) + sizeof(vlock) +
+               (word % region->config.block_words) * region->alignment;
+    }
+    return vaddrof(opaque, segment->vaddr_base);
+}
+
 #endif
\ No newline at end of file
@@ -0,0 +1,386 @@
+#include "segment.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <strings.h>
+
+#include "cm.h"
+#include "epoch.h"
+#include "history.h"
+#include "macros.h"
+#include "memory.h"
+#include "sync.h"
+
+#define STACK_EMPTY 0 /* segment 0 is never freed, so index 0 ends a stack */
+#define stackindex(head) ((head) & 0xffff)
+#define stacktag(head) ((head) >> 16)
+
+/* vlocks guarding a segment of n words, one per 2^grain words, all at version 0 */
+static segment_meta *meta_create(region *region, uint64_t n, uint64_t grain)
+{
+    size_t bytes = sizeof(segment_meta) + sizeof(vlock) * ((n >> grain) + 1);
+    segment_meta *meta = memory_alloc(region, bytes, CACHE_LINE);
+    if (unlikely(!meta))
+    {
+        return NULL;
+    }
+    meta->grain = grain;
+    meta->bytes = bytes;
+    return meta;
+}
+
+static void meta_reclaim(region *region, region_thread *unused(thread), void *ptr)
+{
+    if (ptr)
+    {
+        memory_free(region, ptr, ((segment_meta *)ptr)->bytes, CACHE_LINE);
+    }
+}
+
+static void stack_push(region *region, atomic_ulong *stack, uint64_t index)
+{
+    uint64_t head = atomic_load(stack);
+    do
+    {
+        atomic_store_explicit(&region->next_free[index], stackindex(head), memory_order_relaxed);
+    } while (!atomic_compare_exchange_weak(stack, &head, ((stacktag(head) + 1) << 16) | index));
+}
+
+static uint64_t stack_pop(region *region, atomic_ulong *stack)
+{
+    uint64_t head = atomic_load(stack), next;
+    do
+    {
+        if (stackindex(head) == STACK_EMPTY)
+        {
+            return STACK_EMPTY;
+        }
+        next = atomic_load_explicit(&region->next_free[stackindex(head)], memory_order_relaxed);
+    } while (!atomic_compare_exchange_weak(stack, &head, ((stacktag(head) + 1) << 16) | next));
+    return stackindex(head);
+}
+
+static uint64_t classof(size_t size)
+{
+    uint64_t class = size > 1 ? 64 - __builtin_clzll(size - 1) : 0;
+    if (class < POOL_MIN_CLASS)
+    {
+        class = POOL_MIN_CLASS;
+    }
+    return class > POOL_MAX_CLASS ? POOL_UNPOOLED : class - POOL_MIN_CLASS;
+}
+
+/* alignment of the data, interleaved blocks start on a cache line */
+static size_t segment_align(region *region)
+{
+    if (region->config.vlocks == VLOCKS_INTERLEAVED && region->alignment < CACHE_LINE)
+    {
+        return CACHE_LINE;
+    }
+    return region->alignment;
+}
+
+/* bytes backing the first n words, headers included */
+static size_t segment_bytes(region *region, uint64_t n)
+{
+    if (region->config.vlocks == VLOCKS_INTERLEAVED)
+    {
+        return (n + region->config.block_words - 1) / region->config.block_words * region->config.block_stride;
+    }
+    return n * region->alignment;
+}
+
+static segment *segment_create(region *region, uint16_t index, size_t size, uint64_t class)
+{
+    segment *segment;
+    size_t align = region->alignment, alloc_align = segment_align(region), capacity, bytes;
+
+    capacity = class == POOL_UNPOOLED ? size : (size_t)1 << (class + POOL_MIN_CLASS);
+    bytes = (segment_bytes(region, capacity / align) + alloc_align - 1) & ~(alloc_align - 1);
+
+    segment = malloc(sizeof(struct memory_segment));
+    if (unlikely(!segment))
+    {
+        perror("malloc");
+        traceerror();
+        return NULL;
+    }
+
+    /* zeroed, and mapped on huge pages when large */
+    segment->vaddr = memory_alloc(region, bytes, alloc_align);
+    if (unlikely(!segment->vaddr))
+    {
+        traceerror();
+        free(segment);
+        return NULL;
+    }
+    segment->bytes = bytes;
+
+    segment->index = index;
+    segment->length = size / align;
+    segment->capacity = capacity;
+    segment->class = class;
+    segment->vaddr_base = baseof(segment->vaddr);
+
+    /* striped and interleaved regions keep their vlocks elsewhere */
+    atomic_init(&segment->owner, NULL);
+    atomic_init(&segment->meta, NULL);
+    atomic_init(&segment->samples, 0);
+    atomic_init(&segment->large, 0);
+    atomic_init(&segment->min_large, 0);
+    atomic_init(&segment->coarsening, false);
+    if (region->config.vlocks == VLOCKS_WORD)
+    {
+        atomic_init(&segment->meta, meta_create(region, capacity / align, 0));
+        if (unlikely(!atomic_load(&segment->meta)))
+        {
+            traceerror();
+            memory_free(region, segment->vaddr, bytes, alloc_align);
+            free(segment);
+            return NULL;
+        }
+    }
+    if (unlikely(!history_create(region, segment)))
+    {
+        traceerror();
+        meta_reclaim(region, NULL, atomic_load(&segment->meta));
+        memory_free(region, segment->vaddr, bytes, alloc_align);
+        free(segment);
+        return NULL;
+    }
+
+    return segment;
+}
+
+static segment *segment_reuse(region *region, segment *segment, size_t size)
+{
+    segment->length = size / region->alignment;
+    if (region->config.vlocks != VLOCKS_INTERLEAVED)
+    {
+        bzero(segment->vaddr, segment_bytes(region, segment->length));
+    }
+    else
+    {
+        /* only the data of each block, its header keeps the version a stale reader compares against */
+        for (uint64_t word = 0; word < segment->length; word += region->config.block_words)
+        {
+            bzero(blockof(region, segment, word) + sizeof(vlock), region->config.block_words * region->alignment);
+        }
+    }
+    segment->generation = profile_allocate(region, segment->index);
+    atomic_store(&segment->state, SEGMENT_LIVE);
+    atomic_fetch_add(&region->segment_count, 1);
+    return segment;
+}
+
+/** Allocate a zeroed segment, recycling a freed one of the same size class when possible.
+ * Recycled segments keep their index and their vlocks, whose versions stay valid.
+ * @param thread Slot state of the calling thread, whose cache is looked up first, or NULL
+ * @return Segment registered in region->segments, NULL if out of memory or indices
+ **/
+segment *segment_alloc(region *region, region_thread *thread, size_t size)
+{
+    segment *segment;
+    uint64_t class, index;
+
+    class = classof(size);
+    if (class != POOL_UNPOOLED)
+    {
+        for (uint64_t i = 0; thread && i < thread->cache_size; i++)
+        {
+            if (thread->cache[i]->class == class)
+            {
+                segment = thread->cache[i];
+                thread->cache[i] = thread->cache[--thread->cache_size];
+                return segment_reuse(region, segment, size);
+            }
+        }
+
+        index = stack_pop(region, &region->pool[class]);
+        if (index != STACK_EMPTY)
+        {
+            atomic_fetch_sub(&region->pool_size[class], 1);
+            return segment_reuse(region, region->segments[index], size);
+        }
+    }
+
+    index = stack_pop(region, &region->free_indices);
+    if (index == STACK_EMPTY)
+    {
+        index = atomic_fetch_add(&region->next_segment, 1);
+        if (unlikely(index >= MAX_SEGMENTS))
+        {
+            fprintf(stderr, "warning: max segments %d exceeded\n", MAX_SEGMENTS);
+            return NULL;
+        }
+    }
+
+    segment = segment_create(region, index, size, class);
+    if (unlikely(!segment))
+    {
+        stack_push(region, &region->free_indices, index);
+        return NULL;
+    }
+
+    segment->generation = profile_allocate(region, index);
+    atomic_store(&segment->state, SEGMENT_LIVE);
+    region->segments[index] = segment;
+    atomic_fetch_add(&region->segment_count, 1);
+    return segment;
+}
+
+/* mark a live segment freed, of concurrent frees of the same segment only the first succeeds */
+bool segment_free(region *region, segment *segment)
+{
+    unsigned int state = SEGMENT_LIVE;
+
+    if (!atomic_compare_exchange_strong(&segment->state, &state, SEGMENT_FREE))
+    {
+        return false;
+    }
+    atomic_fetch_sub(&region->segment_count, 1);
+    return true;
+}
+
+/* return a freed segment to its size class, or give its memory and index back if the class is full */
+void segment_recycle(region *region, region_thread *thread, void *ptr)
+{
+    segment *segment = ptr;
+    uint64_t class = segment->class;
+
+    /* old values of the previous allocation are unreachable too */
+    history_clear(region, thread, segment);
+    if (class != POOL_UNPOOLED)
+    {
+        if (atomic_fetch_add(&region->pool_size[class], 1) < POOL_CLASS_LIMIT)
+        {
+            stack_push(region, &region->pool[class], segment->index);
+            return;
+        }
+        atomic_fetch_sub(&region->pool_size[class], 1);
+    }
+
+    region->segments[segment->index] = NULL;
+    stack_push(region, &region->free_indices, segment->index);
+    segment_destroy(region, segment);
+}
+
+/** Take back a segment allocated by a transaction that aborted.
+ * It was never published, so it can be reused right away by the same thread.
+ **/
+void segment_uncommit(region *region, region_thread *thread, segment *segment)
+{
+    atomic_store_explicit(&segment->owner, NULL, memory_order_relaxed);
+    if (!segment_free(region, segment))
+    {
+        return;
+    }
+    if (segment->class != POOL_UNPOOLED && thread->cache_size < SEGMENT_CACHE_SIZE)
+    {
+        thread->cache[thread->cache_size++] = segment;
+        return;
+    }
+    segment_recycle(region, thread, segment);
+}
+
+/* replace the segment's vlocks by one per 2^grain words, once no writer holds the old ones */
+static void segment_coarsen(region *region, handler *handler, segment *segment, uint64_t grain)
+{
+    segment_meta *old, *meta;
+    uint64_t n, snapshot, version;
+
+    old = atomic_load(&segment->meta);
+    n = segment->capacity / region->alignment;
+    meta = meta_create(region, n, grain);
+    if (unlikely(!meta))
+    {
+        traceerror();
+        return;
+    }
+
+    /* lock the old vlocks for good: readers and writers still using them abort, */
+    /* and each coarse vlock starts at the newest version it replaces            */
+    for (uint64_t i = 0; i < n; i++)
+    {
+        for (uint64_t attempt = 0; !vlock_try_acquire(&old->vlocks[i], &snapshot, VLOCK_RETIRED); attempt++)
+        {
+            cm_pause(attempt);
+        }
+        version = atomic_load_explicit(&meta->vlocks[i >> grain], memory_order_relaxed);
+        if (snapshot > version)
+        {
+            atomic_store_explicit(&meta->vlocks[i >> grain], snapshot, memory_order_relaxed);
+        }
+    }
+
+    atomic_store(&segment->meta, meta);
+    epoch_retire(region, handler, old, meta_reclaim);
+}
+
+/** Sample the length of an access to a published segment.
+ * Once nearly all sampled accesses are large, the segment switches to one vlock per record-sized
+ * block, so large-record transactions carry metadata proportional to records rather than words.
+ * Vlocks only ever get coarser: words that shared a vlock keep sharing one.
+ * @param n_words Length of the access, in words
+ **/
+void segment_adapt(region *region, handler *handler, segment *segment, uint64_t n_words)
+{
+    uint64_t samples, large, shortest, grain;
+
+    if (atomic_load_explicit(&segment->meta, memory_order_relaxed)->grain)
+    {
+        return;
+    }
+
+    if (n_words >= region->config.adapt_words)
+    {
+        atomic_fetch_add_explicit(&segment->large, 1, memory_order_relaxed);
+        shortest = atomic_load_explicit(&segment->min_large, memory_order_relaxed);
+        while ((!shortest || n_words < shortest) &&
+               !atomic_compare_exchange_weak(&segment->min_large, &shortest, n_words))
+            ;
+    }
+    samples = atomic_fetch_add_explicit(&segment->samples, 1, memory_order_relaxed) + 1;
+    if (samples != ADAPT_WINDOW)
+    {
+        return;
+    }
+
+    /* decide on this window and start the next one */
+    large = atomic_exchange_explicit(&segment->large, 0, memory_order_relaxed);
+    shortest = atomic_exchange_explicit(&segment->min_large, 0, memory_order_relaxed);
+    atomic_store_explicit(&segment->samples, 0, memory_order_relaxed);
+    if (large * 8 < samples * 7 || !shortest || atomic_exchange(&segment->coarsening, true))
+    {
+        return;
+    }
+
+    grain = 63 - __builtin_clzll(shortest);
+    if (!grain)
+    {
+        atomic_store(&segment->coarsening, false);
+        return;
+    }
+    segment_coarsen(region, handler, segment, grain < ADAPT_MAX_GRAIN ? grain : ADAPT_MAX_GRAIN);
+    atomic_store(&segment->coarsening, false);
+}
+
+void segment_destroy(region *region, segment *segment)
+{
+    history_destroy(region, segment);
+    memory_free(region, segment->vaddr, segment->bytes, segment_align(region));
+    meta_reclaim(region, NULL, atomic_load(&segment->meta));
+    free(segment);
+}
+
+void segment_destroy_all(region *region)
+{
+    uint64_t n = atomic_load(&region->next_segment);
+    for (uint64_t i = 0; i < n && i < MAX_SEGMENTS; i++)
+    {
+        if (region->segments[i])
+        {
+            segment_destroy(region, region->segments[i]);
+        }
+    }
+}
@@ -0,0 +1,28 @@
+#ifndef SEGMENT_H
+#define SEGMENT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "handler.h"
+#include "region.h"
+
+#define POOL_MIN_CLASS 6    /* smallest pooled capacity, 2^6 bytes */
+#define POOL_MAX_CLASS 20   /* largest pooled capacity, 2^20 bytes */
+#define POOL_CLASS_LIMIT 64 /* freed segments kept per size class */
+#define POOL_UNPOOLED POOL_CLASSES
+
+#define ADAPT_PERIOD 16   /* accesses per thread between two samples, power of 2 */
+#define ADAPT_WINDOW 256  /* samples per segment before deciding */
+#define ADAPT_MAX_GRAIN 9 /* coarsest vlock, 2^9 words */
+
+segment *segment_alloc(region *region, region_thread *thread, size_t size);
+bool segment_free(region *region, segment *segment);
+void segment_recycle(region *region, region_thread *thread, void *ptr);
+void segment_uncommit(region *region, region_thread *thread, segment *segment);
+void segment_adapt(region *region, handler *handler, segment *segment, uint64_t n_words);
+void segment_destroy(region *region, segment *segment);
+void segment_destroy_all(region *region);
+
+#endif
@@ -0,0 +1,65 @@
+#include "serial.h"
+
+#include <stdatomic.h>
+
+#include "cm.h"
+#include "epoch.h"
+#include "macros.h"
+
+/** Enter the epoch for a new transaction, first waiting for an irrevocable transaction to end.
+ * The token is checked after the epoch is announced, and the token holder scans announcements
+ * after taking it, so either this transaction waits or the holder waits for it.
+ **/
+void serial_enter(region *region, handler *handler)
+{
+    for (;;)
+    {
+        epoch_enter(region, handler);
+        if (likely(!atomic_load(&region->irrevocable)))
+        {
+            return;
+        }
+        epoch_exit(region, handler);
+        for (uint64_t attempt = 0; atomic_load_explicit(&region->irrevocable, memory_order_relaxed); attempt++)
+        {
+            cm_pause(attempt);
+        }
+    }
+}
+
+/** Take the region's token and wait until every other transaction has ended.
+ * The caller then runs alone: it accesses memory in place and cannot abort.
+ **/
+void serial_begin(region *region, handler *handler)
+{
+    uint64_t expected, slots;
+
+    for (uint64_t attempt = 0;; attempt++)
+    {
+        expected = 0;
+        if (!atomic_load_explicit(&region->irrevocable, memory_order_relaxed) &&
+            atomic_compare_exchange_strong(&region->irrevocable, &expected, handler->slot + 1))
+        {
+            break;
+        }
+        cm_pause(attempt);
+    }
+    epoch_enter(region, handler);
+
+    /* transactions that missed the token are announced, and end without waiting for this one */
+    slots = handler_slots();
+    for (uint64_t i = 0; i < slots; i++)
+    {
+        for (uint64_t attempt = 0; i != handler->slot && atomic_load(&region->threads[i].epoch) != EPOCH_QUIESCENT;
+             attempt++)
+        {
+            cm_pause(attempt);
+        }
+    }
+}
+
+/* let other transactions start again, after the irrevocable one has left its epoch */
+void serial_end(region *region)
+{
+    atomic_store(&region->irrevocable, 0);
+}
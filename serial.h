@@ -0,0 +1,11 @@
+#ifndef SERIAL_H
+#define SERIAL_H
+
+#include "handler.h"
+#include "region.h"
+
+void serial_enter(region *region, handler *handler);
+void serial_begin(region *region, handler *handler);
+void serial_end(region *region);
+
+#endif
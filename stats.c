@@ -0,0 +1,68 @@
+#include "stats.h"
+
+#include <string.h>
+
+#include "handler.h"
+#include "region.h"
+
+/** [thread-safe] Sum the counters of every thread that used a region.
+ * Counters are read while transactions may still run, so the sums are approximate until they stop.
+ * @param shared Shared memory region
+ * @param stats  Receives the sums
+ **/
+void tm_stats(shared_t shared, tm_stats_t *stats)
+{
+    region *region = shared;
+    thread_stats *thread;
+
+    memset(stats, 0, sizeof(*stats));
+    for (uint64_t slot = 0; slot < handler_slots(); slot++)
+    {
+        thread = &region->threads[slot].stats;
+        stats->commits += atomic_load_explicit(&thread->commits, memory_order_relaxed);
+        stats->ro_commits += atomic_load_explicit(&thread->ro_commits, memory_order_relaxed);
+        for (int cause = ABORT_NONE + 1; cause < ABORT_CAUSES; cause++)
+        {
+            stats->abort_causes[cause] += atomic_load_explicit(&thread->aborts[cause], memory_order_relaxed);
+        }
+        stats->reads += atomic_load_explicit(&thread->reads, memory_order_relaxed);
+        stats->writes += atomic_load_explicit(&thread->writes, memory_order_relaxed);
+        if (atomic_load_explicit(&thread->max_reads, memory_order_relaxed) > stats->max_reads)
+        {
+            stats->max_reads = atomic_load_explicit(&thread->max_reads, memory_order_relaxed);
+        }
+        if (atomic_load_explicit(&thread->max_writes, memory_order_relaxed) > stats->max_writes)
+        {
+            stats->max_writes = atomic_load_explicit(&thread->max_writes, memory_order_relaxed);
+        }
+        stats->validations += atomic_load_explicit(&thread->validations, memory_order_relaxed);
+        stats->extensions += atomic_load_explicit(&thread->extensions, memory_order_relaxed);
+        stats->irrevocable += atomic_load_explicit(&thread->irrevocable, memory_order_relaxed);
+    }
+    for (int cause = ABORT_NONE + 1; cause < ABORT_CAUSES; cause++)
+    {
+        stats->aborts += stats->abort_causes[cause];
+    }
+}
+
+/* bytes of tm_stats_t, so that programs declaring their own copy can tell it drifted */
+size_t tm_stats_size(void)
+{
+    return sizeof(tm_stats_t);
+}
+
+/* short name of an abort cause, for reports */
+char const *tm_abort_cause(abort_cause cause)
+{
+    static char const *const names[] = {
+        [ABORT_NONE] = "none",
+        [ABORT_READ_CONFLICT] = "read_conflict",
+        [ABORT_EXTEND] = "extend",
+        [ABORT_READ_ATTEMPTS] = "read_attempts",
+        [ABORT_LOCK] = "lock",
+        [ABORT_VALIDATE_OUTDATED] = "validate_outdated",
+        [ABORT_VALIDATE_LOCKED] = "validate_locked",
+        [ABORT_NOMEM] = "nomem",
+    };
+    return cause < ABORT_CAUSES ? names[cause] : "unknown";
+}
@@ -0,0 +1,71 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "tm.h"
+
+/* why a transaction aborted, mirrored by bench/bench.h, which checks tm_stats_size() */
+typedef enum abort_cause
+{
+    ABORT_NONE,
+    ABORT_READ_CONFLICT,     /* read a locked or newer word, snapshot extension disabled or unavailable */
+    ABORT_EXTEND,            /* read a locked or newer word, snapshot extension failed validation */
+    ABORT_READ_ATTEMPTS,     /* read a word that kept changing RO_VALIDATE_ATTEMPTS times */
+    ABORT_LOCK,              /* commit could not acquire a lock of the write set */
+    ABORT_VALIDATE_OUTDATED, /* commit validation found a read word overwritten */
+    ABORT_VALIDATE_LOCKED,   /* commit validation found a read word locked by another transaction */
+    ABORT_NOMEM,             /* the redo log, an allocation log or the history of old values could not grow */
+    ABORT_CAUSES,
+} abort_cause;
+
+/* counters of a region, summed over the threads that used it, mirrored by bench/bench.h */
+typedef struct tm_stats_t
+{
+    uint64_t commits;
+    uint64_t ro_commits; /* of which read-only */
+    uint64_t aborts;
+    uint64_t abort_causes[ABORT_CAUSES];
+    uint64_t reads;       /* read-set entries of committed transactions */
+    uint64_t writes;      /* words written by committed transactions */
+    uint64_t max_reads;   /* largest read set of a committed transaction */
+    uint64_t max_writes;  /* largest write set of a committed transaction */
+    uint64_t validations; /* read-set validations, at commit and for extensions */
+    uint64_t extensions;  /* successful snapshot extensions */
+    uint64_t irrevocable; /* commits that ran alone after TM_IRREVOCABLE_AFTER aborts */
+} tm_stats_t;
+
+/* per-thread counters, only written by their thread so updates are plain loads and stores */
+typedef struct thread_stats
+{
+    atomic_ulong commits;
+    atomic_ulong ro_commits;
+    atomic_ulong aborts[ABORT_CAUSES];
+    atomic_ulong reads;
+    atomic_ulong writes;
+    atomic_ulong max_reads;
+    atomic_ulong max_writes;
+    atomic_ulong validations;
+    atomic_ulong extensions;
+    atomic_ulong irrevocable;
+} thread_stats;
+
+#define stat_add(counter, n)                                                                     \
+    atomic_store_explicit(&(counter), atomic_load_explicit(&(counter), memory_order_relaxed) + (n), \
+                          memory_order_relaxed)
+#define stat_max(counter, n)                                                    \
+    do                                                                          \
+    {                                                                           \
+        if ((uint64_t)(n) > atomic_load_explicit(&(counter), memory_order_relaxed)) \
+        {                                                                       \
+            atomic_store_explicit(&(counter), (n), memory_order_relaxed);       \
+        }                                                                       \
+    } while (0)
+
+void tm_stats(shared_t shared, tm_stats_t *stats);
+size_t tm_stats_size(void);
+char const *tm_abort_cause(abort_cause cause);
+
+#endif
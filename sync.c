@@ -2,13 +2,25 @@
 
 #include <stdint.h>
 #include <stdio.h>
+#include <string.h>
 
 #include "macros.h"
 
-inline bool vlock_unlocked_old(vlock *vlock, uint64_t ts)
+/** Copy the data a vlock guards, if it is unlocked and no newer than a timestamp for the whole copy.
+ * Writers lock before writing back, so an unchanged vlock means no write overlapped the copy.
+ * @param size Bytes to copy from src to dest
+ * @return Whether the copy is consistent as of the timestamp
+ **/
+inline bool vlock_read(vlock *vlock, void const *src, void *dest, uint64_t size, uint64_t ts)
 {
     uint64_t snapshot = atomic_load(vlock);
-    return unlocked(snapshot) && (getversion(snapshot) <= ts);
+    if (locked(snapshot) || getversion(snapshot) > ts)
+    {
+        return false;
+    }
+    memcpy(dest, src, size);
+    atomic_thread_fence(memory_order_acquire);
+    return atomic_load_explicit(vlock, memory_order_relaxed) == snapshot;
 }
 
 inline bool vlock_release(vlock *vlock)
@@ -25,49 +37,23 @@ inline bool vlock_release(vlock *vlock)
     return false;
 }
 
-inline bool vlock_bounded_spinlock_acquire(vlock *vlock)
-{
-    uint64_t _vlock = atomic_load(vlock);
-    uint64_t desired = getversion(_vlock) | ((uint64_t)1 << 63);
-    uint64_t expected;
-    for (uint64_t i = 0; i < SPINLOCK_BOUND; i++)
-    {
-        expected = getversion(_vlock);
-        if (atomic_compare_exchange_strong(vlock, &expected, desired))
-        {
-            return true;
-        }
-    }
-    return false;
-}
-
-inline void vlock_update(vlock *vlock, uint64_t version)
+/** Attempt to lock an unlocked vlock once, recording the owner next to the version.
+ * @param snapshot Receives the value of the vlock, which tells the owner if it is locked
+ * @return Whether the vlock was acquired
+ **/
+inline bool vlock_try_acquire(vlock *vlock, uint64_t *snapshot, uint64_t owner)
 {
-    uint64_t lock = getlock(atomic_load(vlock));
-    atomic_store(vlock, lock | version);
-}
-
-inline bool bounded_spinlock_acquire(lock *lock)
-{
-    for (uint64_t i = 0; i < SPINLOCK_BOUND; i++)
+    uint64_t expected = atomic_load_explicit(vlock, memory_order_relaxed);
+    *snapshot = expected;
+    if (locked(expected))
     {
-        bool _unlocked = false;
-        if (atomic_compare_exchange_strong(lock, &_unlocked, LOCKED))
-        {
-            return true;
-        }
+        return false;
     }
-    return false;
-}
-
-inline bool lock_release(lock *lock)
-{
-    bool _locked = true;
-    if (atomic_compare_exchange_strong(lock, &_locked, UNLOCKED))
+    if (atomic_compare_exchange_weak(vlock, &expected,
+                                     expected | ((uint64_t)1 << 63) | (owner << VLOCK_OWNER_SHIFT)))
     {
         return true;
     }
-    fprintf(stderr, "attempted to unlock already unlocked lock\n");
-    traceerror();
+    *snapshot = expected;
     return false;
-}
\ No newline at end of file
+}
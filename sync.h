@@ -7,25 +7,21 @@
 
 #define SPINLOCK_BOUND 100
 
-#define LOCKED true
-#define UNLOCKED false
-
-/* versioned lock */
+/* versioned lock: lock bit | owner (15 bits, while locked) | version (48 bits) */
 typedef atomic_ulong vlock;
 
+#define VLOCK_OWNER_SHIFT 48
+#define VLOCK_MAX_OWNERS ((uint64_t)1 << 15)
+#define VLOCK_RETIRED (VLOCK_MAX_OWNERS - 1) /* owner of vlocks replaced by coarser ones, locked for good */
+
 #define locked(vlock) (getlock(vlock) >> 63 == (uint64_t)1)
 #define unlocked(vlock) (!locked(vlock))
 #define getlock(l) (l & ((uint64_t)1 << 63))
-#define getversion(v) (uint64_t)(v & (((uint64_t)1 << 63) - 1))
+#define getversion(v) (uint64_t)(v & (((uint64_t)1 << VLOCK_OWNER_SHIFT) - 1))
+#define getowner(v) (uint64_t)((v >> VLOCK_OWNER_SHIFT) & (VLOCK_MAX_OWNERS - 1))
 
-bool vlock_unlocked_old(vlock *vlock, uint64_t ts);
+bool vlock_read(vlock *vlock, void const *src, void *dest, uint64_t size, uint64_t ts);
 bool vlock_release(vlock *vlock);
-bool vlock_bounded_spinlock_acquire(vlock *vlock);
-void vlock_update(vlock *vlock, uint64_t version);
-
-/* traditional lock */
-typedef atomic_bool lock;
-bool bounded_spinlock_acquire(lock *lock);
-bool lock_release(lock *lock);
+bool vlock_try_acquire(vlock *vlock, uint64_t *snapshot, uint64_t owner);
 
 #endif
\ No newline at end of file
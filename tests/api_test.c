@@ -0,0 +1,986 @@
+/**
+ * Tests of single behaviours of the transactional memory library.
+ *
+ * Linked against the library objects like tm_test, each case sets the TM_* environment variables
+ * it needs, creates its own region, steers one situation (a conflict, an abort, a starving
+ * thread) and checks what the library reports or does about it. Threads are stepped through
+ * barriers, and the few states the API does not expose are read from the library's headers.
+ *
+ * Usage: api_test
+ **/
+
+#define _POSIX_C_SOURCE 200809L
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "tm.h"
+
+#include "../handler.h"
+#include "../region.h"
+
+#define WORDS 64
+#define LONG_TRANSACTIONS 200  /* committed by the long-lived thread */
+#define FRESH_THREADS 4        /* spawned at once, again and again while it runs */
+#define FRESH_TRANSACTIONS 16  /* committed by each spawned thread */
+#define DEADLINE_NS 30000000000 /* for the long-lived thread, against a livelock */
+#define BUSY_TRANSACTIONS 100  /* committed by a thread before the one whose age is checked */
+#define HOLD_YIELDS 100        /* a vlock is held while a reader waits on it */
+#define FORCED_CONFLICTS 3     /* aborts steered one at a time */
+#define COUNTING_THREADS 4     /* incrementing threads that count their own commits and aborts */
+#define COUNTING_TRANSACTIONS 2000
+#define RECLAIM_TRANSACTIONS 256 /* empty ones, enough for the epochs to give a freed segment back */
+
+typedef uint64_t word;
+
+typedef struct api_case
+{
+    char const *name;
+    bool (*run)(void);
+} api_case;
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + (uint64_t)ts.tv_nsec;
+}
+
+/** Region of WORDS zeroed words.
+ * @param env NAME=value variables set for tm_create and unset after, NULL-terminated
+ **/
+static shared_t region_create(char const *const *env)
+{
+    char name[64];
+    char const *value;
+    shared_t shared;
+
+    for (uint64_t i = 0; env[i]; i++)
+    {
+        value = strchr(env[i], '=');
+        snprintf(name, sizeof(name), "%.*s", (int)(value - env[i]), env[i]);
+        setenv(name, value + 1, 1);
+    }
+    shared = tm_create(WORDS * sizeof(word), sizeof(word));
+    for (uint64_t i = 0; env[i]; i++)
+    {
+        snprintf(name, sizeof(name), "%.*s", (int)(strchr(env[i], '=') - env[i]), env[i]);
+        unsetenv(name);
+    }
+    if (shared == invalid_shared)
+    {
+        fprintf(stderr, "tm_create failed\n");
+    }
+    return shared;
+}
+
+/* Contention: a long-lived thread keeps winning against threads younger than its transactions */
+
+typedef struct stepper
+{
+    shared_t shared;
+    pthread_barrier_t step;
+    uint64_t priority; /* of the busy thread's transaction, as first recorded */
+    bool passed;
+} stepper;
+
+static uint64_t priority_of(shared_t shared, tx_t tx)
+{
+    region *region = shared;
+    return atomic_load(&region->threads[((handler *)tx)->slot].priority);
+}
+
+/* once the busy thread's transaction read the first word, compare the ages and overwrite the word */
+static void *fresh_age(void *arg)
+{
+    stepper *s = arg;
+    word value = 2;
+    tx_t tx;
+
+    pthread_barrier_wait(&s->step);
+    tx = tm_begin(s->shared, false);
+    if (priority_of(s->shared, tx) <= s->priority)
+    {
+        fprintf(stderr, "fresh thread older than a running transaction\n");
+        s->passed = false;
+    }
+    if (!tm_write(s->shared, tx, &value, sizeof(word), tm_start(s->shared)) || !tm_end(s->shared, tx))
+    {
+        fprintf(stderr, "uncontended transaction aborted\n");
+        s->passed = false;
+    }
+    pthread_barrier_wait(&s->step);
+    return NULL;
+}
+
+/* a busy thread's transaction is older than any begun after it, across its retries */
+static bool contention_age(void)
+{
+    stepper s = {.passed = true};
+    word *words, value = 1;
+    pthread_t fresh;
+    tx_t tx;
+
+    s.shared = region_create((char const *[]){"TM_CM=greedy", NULL});
+    if (s.shared == invalid_shared)
+    {
+        return false;
+    }
+    words = tm_start(s.shared);
+    for (uint64_t i = 0; i < BUSY_TRANSACTIONS; i++)
+    {
+        tx = tm_begin(s.shared, false);
+        if (!tm_write(s.shared, tx, &value, sizeof(word), &words[1]) || !tm_end(s.shared, tx))
+        {
+            fprintf(stderr, "uncontended transaction aborted\n");
+            return false;
+        }
+    }
+
+    pthread_barrier_init(&s.step, NULL, 2);
+    tx = tm_begin(s.shared, false);
+    s.priority = priority_of(s.shared, tx);
+    if (!tm_read(s.shared, tx, &words[0], sizeof(word), &value))
+    {
+        return false;
+    }
+    if (pthread_create(&fresh, NULL, fresh_age, &s) != 0)
+    {
+        perror("pthread_create");
+        exit(EXIT_FAILURE);
+    }
+    pthread_barrier_wait(&s.step);
+    pthread_barrier_wait(&s.step);
+    pthread_join(fresh, NULL);
+
+    /* the word read was overwritten, so the commit fails and the retry keeps the first attempt's age */
+    if (!tm_write(s.shared, tx, &value, sizeof(word), &words[1]) || tm_end(s.shared, tx))
+    {
+        fprintf(stderr, "outdated transaction committed\n");
+        return false;
+    }
+    tx = tm_begin(s.shared, false);
+    if (priority_of(s.shared, tx) != s.priority)
+    {
+        fprintf(stderr, "retry did not keep its age\n");
+        s.passed = false;
+    }
+    tm_end(s.shared, tx);
+
+    pthread_barrier_destroy(&s.step);
+    tm_destroy(s.shared);
+    return s.passed;
+}
+
+static atomic_bool long_done;
+
+/* blind writes of every word, only lock conflicts at commit can abort it */
+static void *long_run(void *arg)
+{
+    shared_t shared = arg;
+    word *words = tm_start(shared);
+    tx_t tx;
+    bool written;
+
+    for (word i = 1; i <= LONG_TRANSACTIONS; i++)
+    {
+        do
+        {
+            tx = tm_begin(shared, false);
+            written = true;
+            for (uint64_t w = 0; w < WORDS && written; w++)
+            {
+                written = tm_write(shared, tx, &i, sizeof(word), &words[w]);
+            }
+        } while (!written || !tm_end(shared, tx));
+    }
+    atomic_store(&long_done, true);
+    return NULL;
+}
+
+/* increments of one word, by a thread that takes a fresh descriptor and exits soon after */
+static void *fresh_run(void *arg)
+{
+    shared_t shared = arg;
+    word *words = tm_start(shared), value;
+    unsigned seed = (unsigned)now_ns();
+    tx_t tx;
+    uint64_t w;
+
+    for (uint64_t i = 0; i < FRESH_TRANSACTIONS; i++)
+    {
+        w = (uint64_t)rand_r(&seed) % WORDS;
+        do
+        {
+            tx = tm_begin(shared, false);
+            if (!tm_read(shared, tx, &words[w], sizeof(word), &value))
+            {
+                continue;
+            }
+            value++;
+            if (tm_write(shared, tx, &value, sizeof(word), &words[w]) && tm_end(shared, tx))
+            {
+                break;
+            }
+        } while (true);
+    }
+    return NULL;
+}
+
+static bool contention_run(char const *cm)
+{
+    char variable[64];
+    pthread_t long_thread, fresh[FRESH_THREADS];
+    uint64_t start = now_ns(), spawned = 0;
+    shared_t shared;
+    bool done;
+
+    snprintf(variable, sizeof(variable), "TM_CM=%s", cm);
+    shared = region_create((char const *[]){variable, NULL});
+    if (shared == invalid_shared)
+    {
+        return false;
+    }
+    atomic_store(&long_done, false);
+    if (pthread_create(&long_thread, NULL, long_run, shared) != 0)
+    {
+        perror("pthread_create");
+        exit(EXIT_FAILURE);
+    }
+    while (!atomic_load(&long_done) && now_ns() - start < DEADLINE_NS)
+    {
+        for (uint64_t i = 0; i < FRESH_THREADS; i++)
+        {
+            if (pthread_create(&fresh[i], NULL, fresh_run, shared) != 0)
+            {
+                perror("pthread_create");
+                exit(EXIT_FAILURE);
+            }
+        }
+        for (uint64_t i = 0; i < FRESH_THREADS; i++)
+        {
+            pthread_join(fresh[i], NULL);
+        }
+        spawned += FRESH_THREADS;
+    }
+    done = atomic_load(&long_done);
+    if (!done)
+    {
+        fprintf(stderr, "%s: long-lived thread starved by %lu fresh threads\n", cm, spawned);
+        /* it holds no lock between attempts, and will finish once nothing competes */
+    }
+    pthread_join(long_thread, NULL);
+    tm_destroy(shared);
+    return done;
+}
+
+static bool contention_greedy(void)
+{
+    return contention_run("greedy");
+}
+
+static bool contention_timestamp(void)
+{
+    return contention_run("timestamp");
+}
+
+/* Versions: reads served by the history, and snapshots that still extend after a current one */
+
+typedef struct overwriter
+{
+    shared_t shared;
+    word *target;
+    word value;
+} overwriter;
+
+static void *overwrite_run(void *arg)
+{
+    overwriter *o = arg;
+    tx_t tx;
+
+    do
+    {
+        tx = tm_begin(o->shared, false);
+    } while (!tm_write(o->shared, tx, &o->value, sizeof(word), o->target) || !tm_end(o->shared, tx));
+    return NULL;
+}
+
+/* commit a write from a thread of its own, while the caller's transaction keeps its snapshot */
+static void overwrite(shared_t shared, word *target, word value)
+{
+    overwriter o = {shared, target, value};
+    pthread_t thread;
+
+    if (pthread_create(&thread, NULL, overwrite_run, &o) != 0)
+    {
+        perror("pthread_create");
+        exit(EXIT_FAILURE);
+    }
+    pthread_join(thread, NULL);
+}
+
+typedef struct holder
+{
+    vlock *vlock;
+    pthread_barrier_t locked;
+} holder;
+
+/* lock a vlock as a committer would, then release it with its version unchanged */
+static void *hold_run(void *arg)
+{
+    holder *h = arg;
+    uint64_t snapshot;
+
+    while (!vlock_try_acquire(h->vlock, &snapshot, 1))
+    {
+    }
+    pthread_barrier_wait(&h->locked);
+    for (uint64_t i = 0; i < HOLD_YIELDS; i++)
+    {
+        sched_yield();
+    }
+    vlock_release(h->vlock);
+    return NULL;
+}
+
+/* an overwritten value read from the history pins the snapshot, a current value found there does not */
+static bool versions_extend(void)
+{
+    shared_t shared = region_create((char const *[]){"TM_VERSIONS=1", "TM_RO_EXTEND=1", NULL});
+    region *region = shared;
+    word *words, value;
+    pthread_t thread;
+    holder h;
+    tx_t tx;
+    bool passed = true;
+
+    if (shared == invalid_shared)
+    {
+        return false;
+    }
+    words = tm_start(shared);
+
+    tx = tm_begin(shared, true);
+    overwrite(shared, &words[0], 1);
+    if (!tm_read(shared, tx, &words[0], sizeof(word), &value))
+    {
+        fprintf(stderr, "overwritten value not kept\n");
+        return false;
+    }
+    if (value != 0 || !((handler *)tx)->r_overflow)
+    {
+        fprintf(stderr, "overwritten value not read from the history\n");
+        passed = false;
+    }
+    tm_end(shared, tx);
+
+    /* the word is locked when the read starts and current again once the history is looked up */
+    tx = tm_begin(shared, true);
+    h.vlock = getvlock(region, region->segments[0], &words[1]);
+    pthread_barrier_init(&h.locked, NULL, 2);
+    if (pthread_create(&thread, NULL, hold_run, &h) != 0)
+    {
+        perror("pthread_create");
+        exit(EXIT_FAILURE);
+    }
+    pthread_barrier_wait(&h.locked);
+    if (!tm_read(shared, tx, &words[1], sizeof(word), &value))
+    {
+        fprintf(stderr, "read of a word locked and released unchanged aborted\n");
+        return false;
+    }
+    pthread_join(thread, NULL);
+    pthread_barrier_destroy(&h.locked);
+    if (((handler *)tx)->r_overflow)
+    {
+        fprintf(stderr, "current value pinned the snapshot\n");
+        passed = false;
+    }
+
+    /* a single kept version is too new for the snapshot, which has to extend instead */
+    overwrite(shared, &words[2], 1);
+    overwrite(shared, &words[2], 2);
+    if (!tm_read(shared, tx, &words[2], sizeof(word), &value))
+    {
+        fprintf(stderr, "snapshot did not extend\n");
+        return false;
+    }
+    if (value != 2 || !tm_end(shared, tx))
+    {
+        fprintf(stderr, "extended snapshot read %lu\n", value);
+        passed = false;
+    }
+    tm_destroy(shared);
+    return passed;
+}
+
+/* Statistics: tm_stats agrees with the commits and aborts the callers saw */
+
+/* a read-write transaction whose read is overwritten before it commits, which then fails validation */
+static bool conflict_force(shared_t shared, word *read, word *written, word value)
+{
+    word old;
+    tx_t tx = tm_begin(shared, false);
+
+    if (!tm_read(shared, tx, read, sizeof(word), &old))
+    {
+        return false;
+    }
+    overwrite(shared, read, old + 1);
+    return tm_write(shared, tx, &value, sizeof(word), written) && !tm_end(shared, tx);
+}
+
+typedef struct counter
+{
+    shared_t shared;
+    pthread_t thread;
+    uint64_t commits;
+    uint64_t aborts; /* every false return of the API, each ends one attempt */
+} counter;
+
+static void *count_run(void *arg)
+{
+    counter *c = arg;
+    word *words = tm_start(c->shared), value;
+    tx_t tx;
+
+    for (uint64_t i = 0; i < COUNTING_TRANSACTIONS; i++)
+    {
+        do
+        {
+            tx = tm_begin(c->shared, false);
+            if (!tm_read(c->shared, tx, &words[0], sizeof(word), &value))
+            {
+                c->aborts++;
+                continue;
+            }
+            value++;
+            if (!tm_write(c->shared, tx, &value, sizeof(word), &words[0]) || !tm_end(c->shared, tx))
+            {
+                c->aborts++;
+                continue;
+            }
+            break;
+        } while (true);
+        c->commits++;
+    }
+    return NULL;
+}
+
+static bool stats_counts(void)
+{
+    shared_t shared = region_create((char const *[]){NULL});
+    counter counters[COUNTING_THREADS] = {{0}};
+    uint64_t commits = 0, ro_commits = 0, aborts = 0, causes = 0;
+    word *words, value = 1;
+    tm_stats_t stats;
+    tx_t tx;
+    bool passed = true;
+
+    if (shared == invalid_shared)
+    {
+        return false;
+    }
+    words = tm_start(shared);
+
+    /* steered: one overwrite commit and one validation abort per conflict, then a plain commit each */
+    for (uint64_t i = 0; i < FORCED_CONFLICTS; i++)
+    {
+        if (!conflict_force(shared, &words[0], &words[1], value))
+        {
+            fprintf(stderr, "forced conflict did not abort\n");
+            return false;
+        }
+        commits++;
+        aborts++;
+        tx = tm_begin(shared, i % 2);
+        if (!tm_read(shared, tx, &words[0], sizeof(word), &value) || !tm_end(shared, tx))
+        {
+            fprintf(stderr, "uncontended transaction aborted\n");
+            return false;
+        }
+        commits++;
+        ro_commits += i % 2;
+    }
+    tm_stats(shared, &stats);
+    if (stats.commits != commits || stats.ro_commits != ro_commits || stats.aborts != aborts ||
+        stats.abort_causes[ABORT_VALIDATE_OUTDATED] != aborts)
+    {
+        fprintf(stderr, "stats: %lu commits, %lu read-only, %lu aborts (%lu %s), expected %lu, %lu, %lu\n",
+                stats.commits, stats.ro_commits, stats.aborts, stats.abort_causes[ABORT_VALIDATE_OUTDATED],
+                tm_abort_cause(ABORT_VALIDATE_OUTDATED), commits, ro_commits, aborts);
+        passed = false;
+    }
+
+    /* concurrent: whatever aborts the threads ran into, each is counted once under one cause */
+    for (uint64_t i = 0; i < COUNTING_THREADS; i++)
+    {
+        counters[i].shared = shared;
+        if (pthread_create(&counters[i].thread, NULL, count_run, &counters[i]) != 0)
+        {
+            perror("pthread_create");
+            exit(EXIT_FAILURE);
+        }
+    }
+    for (uint64_t i = 0; i < COUNTING_THREADS; i++)
+    {
+        pthread_join(counters[i].thread, NULL);
+        commits += counters[i].commits;
+        aborts += counters[i].aborts;
+    }
+    tm_stats(shared, &stats);
+    for (int cause = 0; cause < ABORT_CAUSES; cause++)
+    {
+        causes += stats.abort_causes[cause];
+    }
+    if (stats.commits != commits || stats.aborts != aborts || causes != aborts)
+    {
+        fprintf(stderr, "stats: %lu commits, %lu aborts, %lu by cause, expected %lu commits, %lu aborts\n",
+                stats.commits, stats.aborts, causes, commits, aborts);
+        passed = false;
+    }
+    tm_destroy(shared);
+    return passed;
+}
+
+/* Allocation: a segment allocated by an aborted attempt comes back zeroed to its retry */
+
+static bool alloc_reuse_run(char const *vlocks)
+{
+    shared_t shared = region_create((char const *[]){vlocks, NULL});
+    word *words, *first, *second, value = ~(word)0, old;
+    tx_t tx;
+    bool passed = true;
+
+    if (shared == invalid_shared)
+    {
+        return false;
+    }
+    words = tm_start(shared);
+
+    /* dirtied, then given back by a steered abort */
+    tx = tm_begin(shared, false);
+    if (!tm_read(shared, tx, &words[0], sizeof(word), &old) ||
+        tm_alloc(shared, tx, WORDS * sizeof(word), (void **)&first) != success_alloc)
+    {
+        return false;
+    }
+    for (uint64_t i = 0; i < WORDS; i++)
+    {
+        if (!tm_write(shared, tx, &value, sizeof(word), &first[i]))
+        {
+            return false;
+        }
+    }
+    overwrite(shared, &words[0], old + 1);
+    if (!tm_write(shared, tx, &value, sizeof(word), &words[1]) || tm_end(shared, tx))
+    {
+        fprintf(stderr, "%s: forced conflict did not abort\n", vlocks);
+        return false;
+    }
+
+    /* the retry gets the same segment from the thread's cache, then publishes it */
+    tx = tm_begin(shared, false);
+    if (tm_alloc(shared, tx, WORDS * sizeof(word), (void **)&second) != success_alloc)
+    {
+        return false;
+    }
+    if (second != first)
+    {
+        fprintf(stderr, "%s: retry allocated %p, the aborted attempt %p\n", vlocks, (void *)second, (void *)first);
+        passed = false;
+    }
+    for (uint64_t i = 0; i < WORDS; i++)
+    {
+        if (!tm_read(shared, tx, &second[i], sizeof(word), &value))
+        {
+            return false;
+        }
+        if (value != 0)
+        {
+            fprintf(stderr, "%s: word %lu of the reused segment is %lx\n", vlocks, i, value);
+            passed = false;
+        }
+    }
+    if (!tm_write(shared, tx, &second, sizeof(word), &words[2]) || !tm_end(shared, tx))
+    {
+        return false;
+    }
+
+    tx = tm_begin(shared, true);
+    if (!tm_read(shared, tx, &words[2], sizeof(word), &value) || !tm_end(shared, tx) || value != (word)second)
+    {
+        fprintf(stderr, "%s: reused segment not published\n", vlocks);
+        passed = false;
+    }
+    tm_destroy(shared);
+    return passed;
+}
+
+static bool alloc_reuse(void)
+{
+    return alloc_reuse_run("TM_VLOCKS=word") && alloc_reuse_run("TM_VLOCKS=striped") &&
+           alloc_reuse_run("TM_VLOCKS=interleaved");
+}
+
+/* Dumps: checked by a small recursive descent parser, then looked up by their text */
+
+static bool json_value(char const **p);
+
+static void json_space(char const **p)
+{
+    while (**p == ' ' || **p == '\n' || **p == '\t' || **p == '\r')
+    {
+        (*p)++;
+    }
+}
+
+static bool json_string(char const **p)
+{
+    for ((*p)++; **p != '"'; (*p)++)
+    {
+        if ((unsigned char)**p < 0x20 || (**p == '\\' && !*++*p))
+        {
+            return false;
+        }
+    }
+    (*p)++;
+    return true;
+}
+
+static bool json_literal(char const **p, char const *literal)
+{
+    size_t n = strlen(literal);
+
+    if (strncmp(*p, literal, n) != 0)
+    {
+        return false;
+    }
+    *p += n;
+    return true;
+}
+
+static bool json_number(char const **p)
+{
+    char *end;
+
+    if (**p != '-' && (**p < '0' || **p > '9'))
+    {
+        return false;
+    }
+    strtod(*p, &end);
+    *p = end;
+    return true;
+}
+
+/* object members or array elements, up to the closing character */
+static bool json_members(char const **p, char close, bool keys)
+{
+    (*p)++;
+    json_space(p);
+    if (**p == close)
+    {
+        (*p)++;
+        return true;
+    }
+    while (true)
+    {
+        json_space(p);
+        if (keys)
+        {
+            if (**p != '"' || !json_string(p))
+            {
+                return false;
+            }
+            json_space(p);
+            if (**p != ':')
+            {
+                return false;
+            }
+            (*p)++;
+        }
+        if (!json_value(p))
+        {
+            return false;
+        }
+        json_space(p);
+        if (**p != ',')
+        {
+            break;
+        }
+        (*p)++;
+    }
+    if (**p != close)
+    {
+        return false;
+    }
+    (*p)++;
+    return true;
+}
+
+static bool json_value(char const **p)
+{
+    json_space(p);
+    switch (**p)
+    {
+    case '{':
+        return json_members(p, '}', true);
+    case '[':
+        return json_members(p, ']', false);
+    case '"':
+        return json_string(p);
+    case 't':
+        return json_literal(p, "true");
+    case 'f':
+        return json_literal(p, "false");
+    case 'n':
+        return json_literal(p, "null");
+    default:
+        return json_number(p);
+    }
+}
+
+/* contents of a file holding exactly one JSON value, NULL otherwise */
+static char *json_load(char const *path)
+{
+    char const *p;
+    char *text;
+    long size;
+    FILE *file;
+
+    file = fopen(path, "r");
+    if (!file)
+    {
+        perror("fopen");
+        return NULL;
+    }
+    fseek(file, 0, SEEK_END);
+    size = ftell(file);
+    rewind(file);
+    text = calloc(1, (size_t)size + 1);
+    if (!text || fread(text, 1, (size_t)size, file) != (size_t)size)
+    {
+        fprintf(stderr, "could not read %s\n", path);
+        fclose(file);
+        free(text);
+        return NULL;
+    }
+    fclose(file);
+    p = text;
+    if (!json_value(&p) || (json_space(&p), *p))
+    {
+        fprintf(stderr, "%s is not JSON, at offset %ld\n", path, (long)(p - text));
+        free(text);
+        return NULL;
+    }
+    return text;
+}
+
+/* whether a dump holds a fragment, reported if not */
+static bool json_has(char const *text, char const *fragment)
+{
+    if (!strstr(text, fragment))
+    {
+        fprintf(stderr, "dump lacks %s\n", fragment);
+        return false;
+    }
+    return true;
+}
+
+/* Profile: a forced conflict is charged to its word, and a reused segment index to a new generation */
+
+/* allocate a segment of WORDS words and publish it in a word of the first segment */
+static word *segment_publish(shared_t shared, word **slot)
+{
+    void *allocated;
+    tx_t tx;
+
+    tx = tm_begin(shared, false);
+    if (tm_alloc(shared, tx, WORDS * sizeof(word), &allocated) != success_alloc ||
+        !tm_write(shared, tx, &allocated, sizeof(word), slot) || !tm_end(shared, tx))
+    {
+        return NULL;
+    }
+    return allocated;
+}
+
+static bool segment_retire(shared_t shared, word *segment)
+{
+    tx_t tx = tm_begin(shared, false);
+
+    if (!tm_free(shared, tx, segment) || !tm_end(shared, tx))
+    {
+        return false;
+    }
+    for (uint64_t i = 0; i < RECLAIM_TRANSACTIONS; i++)
+    {
+        tx = tm_begin(shared, true);
+        tm_end(shared, tx);
+    }
+    return true;
+}
+
+static bool profile_dump(void)
+{
+    shared_t shared = region_create((char const *[]){"TM_PROFILE_PERIOD=1", NULL});
+    word *words, *first, *second;
+    char path[64], fragment[128], *text;
+    bool passed;
+
+    if (shared == invalid_shared)
+    {
+        return false;
+    }
+    words = tm_start(shared);
+
+    /* one conflict on the third word of the first segment, one on each allocation at a reused index */
+    first = segment_publish(shared, (word **)&words[4]);
+    if (!first || !conflict_force(shared, &words[2], &words[3], 1) ||
+        !conflict_force(shared, &first[5], &words[3], 1) || !segment_retire(shared, first))
+    {
+        fprintf(stderr, "steering failed\n");
+        return false;
+    }
+    second = segment_publish(shared, (word **)&words[4]);
+    if (!second || (uintptr_t)second >> 48 != (uintptr_t)first >> 48)
+    {
+        fprintf(stderr, "freed segment index not reused\n");
+        return false;
+    }
+    if (!conflict_force(shared, &second[5], &words[3], 1))
+    {
+        fprintf(stderr, "steering failed\n");
+        return false;
+    }
+
+    snprintf(path, sizeof(path), "/tmp/api_test_profile_%d.json", (int)getpid());
+    if (!tm_profile_dump(shared, path, 4))
+    {
+        return false;
+    }
+    text = json_load(path);
+    unlink(path);
+    if (!text)
+    {
+        return false;
+    }
+    passed = json_has(text, "\"samples\": 3, \"dropped\": 0");
+    passed &= json_has(text, "{\"segment\": 0, \"generation\": 0, \"samples\": 1, \"words\": 1, \"hot\": [");
+    snprintf(fragment, sizeof(fragment), "{\"offset\": %lu, \"samples\": 1, \"causes\": {\"validate_outdated\": 1}}",
+             2 * sizeof(word));
+    passed &= json_has(text, fragment);
+    for (uint64_t generation = 0; generation < 2; generation++)
+    {
+        snprintf(fragment, sizeof(fragment), "{\"segment\": %lu, \"generation\": %lu, \"samples\": 1,",
+                 (uint64_t)((uintptr_t)first >> 48), generation);
+        passed &= json_has(text, fragment);
+    }
+    snprintf(fragment, sizeof(fragment), "{\"offset\": %lu, \"samples\": 1,", 5 * sizeof(word));
+    passed &= json_has(text, fragment);
+    free(text);
+    tm_destroy(shared);
+    return passed;
+}
+
+/* Trace: the events of a forced conflict, nested as Chrome trace spans */
+
+#ifdef TM_TRACE
+/* occurrences of a fragment in a dump */
+static uint64_t json_count(char const *text, char const *fragment)
+{
+    uint64_t n = 0;
+
+    for (char const *at = strstr(text, fragment); at; at = strstr(at + 1, fragment))
+    {
+        n++;
+    }
+    return n;
+}
+#endif
+
+static bool trace_dump(void)
+{
+    shared_t shared = region_create((char const *[]){NULL});
+    word *words;
+    char path[64];
+    bool passed;
+
+    if (shared == invalid_shared)
+    {
+        return false;
+    }
+    words = tm_start(shared);
+    snprintf(path, sizeof(path), "/tmp/api_test_trace_%d.json", (int)getpid());
+    if (!conflict_force(shared, &words[0], &words[1], 1))
+    {
+        fprintf(stderr, "steering failed\n");
+        return false;
+    }
+#ifndef TM_TRACE
+    /* compiled out, the dump only reports it */
+    passed = !tm_trace_dump(shared, path);
+#else
+    char *text;
+
+    if (!tm_trace_dump(shared, path))
+    {
+        return false;
+    }
+    text = json_load(path);
+    unlink(path);
+    if (!text)
+    {
+        return false;
+    }
+    passed = json_has(text, "\"traceEvents\": [");
+    passed &= json_has(text, "\"name\": \"update\"");
+    passed &= json_has(text, "\"name\": \"locked\"");
+    passed &= json_has(text, "\"args\": {\"result\": \"validate_outdated\"}");
+    passed &= json_has(text, "\"args\": {\"end\": \"abort\", \"cause\": \"validate_outdated\"}");
+    passed &= json_has(text, "\"args\": {\"end\": \"commit\"}");
+    if (json_count(text, "\"ph\": \"B\"") != json_count(text, "\"ph\": \"E\""))
+    {
+        fprintf(stderr, "unbalanced spans\n");
+        passed = false;
+    }
+    free(text);
+#endif
+    tm_destroy(shared);
+    return passed;
+}
+
+static api_case const cases[] = {
+    {"contention_age", contention_age},
+    {"contention_greedy", contention_greedy},
+    {"contention_timestamp", contention_timestamp},
+    {"versions_extend", versions_extend},
+    {"stats_counts", stats_counts},
+    {"alloc_reuse", alloc_reuse},
+    {"profile_dump", profile_dump},
+    {"trace_dump", trace_dump},
+};
+
+#define CASES (sizeof(cases) / sizeof(cases[0]))
+
+int main(void)
+{
+    uint64_t failed = 0;
+    bool passed;
+
+    for (uint64_t c = 0; c < CASES; c++)
+    {
+        passed = cases[c].run();
+        printf("%-6s %s\n", passed ? "ok" : "FAIL", cases[c].name);
+        fflush(stdout);
+        failed += !passed;
+    }
+    printf("%lu of %lu failed\n", failed, CASES);
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,483 @@
+/**
+ * Concurrency tests of the transactional memory library.
+ *
+ * Linked against the library objects and driven through the tm.h API only. Each test runs a
+ * few threads against one region and checks an invariant, both inside transactions (which
+ * must only ever see consistent states) and once the threads are done. The whole set runs
+ * once per configuration of the table below, set through the TM_* environment variables that
+ * tm_create reads.
+ *
+ * Usage: tm_test [-t threads] [-n transactions per thread]
+ **/
+
+#define _POSIX_C_SOURCE 200809L
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "tm.h"
+
+#define DEFAULT_THREADS 4
+#define DEFAULT_TRANSACTIONS 3000
+#define MAX_THREADS 64
+#define MAX_SETTINGS 4
+#define ACCOUNTS 64
+#define INITIAL_BALANCE 100
+#define SLOTS 16      /* records of the allocation test */
+#define RECORD_MAX 8  /* words of the largest record, the first one holds the length */
+
+typedef uint64_t word;
+
+/* environment of one run of every test, unset variables keep their defaults */
+typedef struct setting
+{
+    char const *name;
+    char const *env[MAX_SETTINGS]; /* NAME=value */
+} setting;
+
+static setting const settings[] = {
+    {"word", {NULL}},
+    {"striped", {"TM_VLOCKS=striped", "TM_STRIPES=256"}},
+    {"interleaved", {"TM_VLOCKS=interleaved"}},
+    {"interleaved_wide", {"TM_VLOCKS=interleaved", "TM_BLOCK_SIZE=256"}},
+    {"coarsening", {"TM_ADAPT_WORDS=2"}},
+    {"no_rw_extend", {"TM_RW_EXTEND=0"}},
+    {"ro_extend", {"TM_RO_EXTEND=1"}},
+    {"gv4", {"TM_CLOCK=gv4"}},
+    {"gv5", {"TM_CLOCK=gv5"}},
+    {"gv6", {"TM_CLOCK=gv6", "TM_CLOCK_PERIOD=4"}},
+    {"karma", {"TM_CM=karma"}},
+    {"greedy", {"TM_CM=greedy"}},
+    {"timestamp", {"TM_CM=timestamp"}},
+    {"irrevocable", {"TM_IRREVOCABLE_AFTER=1"}},
+    {"versions", {"TM_VERSIONS=4"}},
+    {"versions_striped", {"TM_VERSIONS=4", "TM_VLOCKS=striped", "TM_CLOCK=gv5"}},
+    {"versions_interleaved", {"TM_VERSIONS=4", "TM_VLOCKS=interleaved", "TM_RO_EXTEND=1"}},
+    {"mapped", {"TM_MMAP_THRESHOLD=4096", "TM_HUGEPAGES=off", "TM_PREFAULT=touch"}},
+};
+
+#define SETTINGS (sizeof(settings) / sizeof(settings[0]))
+
+/* every variable a setting may set */
+static char const *const variables[] = {
+    "TM_VLOCKS", "TM_STRIPES", "TM_BLOCK_SIZE", "TM_ADAPT_WORDS", "TM_RW_EXTEND", "TM_RO_EXTEND",
+    "TM_CLOCK", "TM_CLOCK_PERIOD", "TM_CM", "TM_IRREVOCABLE_AFTER", "TM_VERSIONS", "TM_MMAP_THRESHOLD",
+    "TM_HUGEPAGES", "TM_PREFAULT", NULL,
+};
+
+typedef struct test
+{
+    char const *name;
+    size_t size; /* bytes of the first segment */
+    bool (*init)(shared_t shared);
+    void (*op)(shared_t shared, unsigned *seed); /* one transaction, retried until it commits */
+    bool (*check)(shared_t shared, uint64_t committed);
+} test;
+
+typedef struct worker
+{
+    pthread_t thread;
+    shared_t shared;
+    test const *test;
+    unsigned seed;
+} worker;
+
+static uint64_t transactions = DEFAULT_TRANSACTIONS;
+static atomic_ulong inconsistent; /* states seen inside transactions that break an invariant */
+
+/* Counter: every transaction increments the same word */
+
+static bool counter_init(shared_t shared)
+{
+    (void)shared;
+    return true;
+}
+
+static void counter_op(shared_t shared, unsigned *seed)
+{
+    word *counter = tm_start(shared), value;
+    tx_t tx;
+
+    (void)seed;
+    do
+    {
+        tx = tm_begin(shared, false);
+        if (!tm_read(shared, tx, counter, sizeof(word), &value))
+        {
+            continue;
+        }
+        value++;
+        if (!tm_write(shared, tx, &value, sizeof(word), counter))
+        {
+            continue;
+        }
+        if (tm_end(shared, tx))
+        {
+            return;
+        }
+    } while (true);
+}
+
+static bool counter_check(shared_t shared, uint64_t committed)
+{
+    word value;
+    tx_t tx;
+
+    do
+    {
+        tx = tm_begin(shared, true);
+    } while (!tm_read(shared, tx, tm_start(shared), sizeof(word), &value) || !tm_end(shared, tx));
+    if (value != committed)
+    {
+        fprintf(stderr, "counter at %lu after %lu increments\n", value, committed);
+        return false;
+    }
+    return true;
+}
+
+/* Bank: transfers between two accounts, read-only transactions sum every account in one read */
+
+static bool bank_init(shared_t shared)
+{
+    word *accounts = tm_start(shared), balance = INITIAL_BALANCE;
+    tx_t tx = tm_begin(shared, false);
+
+    for (uint64_t i = 0; i < ACCOUNTS; i++)
+    {
+        if (!tm_write(shared, tx, &balance, sizeof(word), &accounts[i]))
+        {
+            return false;
+        }
+    }
+    return tm_end(shared, tx);
+}
+
+static bool bank_sum(shared_t shared, tx_t tx, bool *consistent)
+{
+    word balances[ACCOUNTS], sum = 0;
+
+    if (!tm_read(shared, tx, tm_start(shared), sizeof(balances), balances))
+    {
+        return false;
+    }
+    for (uint64_t i = 0; i < ACCOUNTS; i++)
+    {
+        sum += balances[i];
+    }
+    *consistent = sum == ACCOUNTS * INITIAL_BALANCE;
+    return true;
+}
+
+static void bank_op(shared_t shared, unsigned *seed)
+{
+    word *accounts = tm_start(shared), from_balance, to_balance, amount;
+    uint64_t from, to;
+    bool scan = rand_r(seed) % 4 == 0, consistent;
+    tx_t tx;
+
+    from = (uint64_t)rand_r(seed) % ACCOUNTS;
+    to = (from + 1 + (uint64_t)rand_r(seed) % (ACCOUNTS - 1)) % ACCOUNTS;
+    do
+    {
+        tx = tm_begin(shared, scan);
+        if (scan)
+        {
+            if (!bank_sum(shared, tx, &consistent))
+            {
+                continue;
+            }
+            if (tm_end(shared, tx))
+            {
+                atomic_fetch_add(&inconsistent, !consistent);
+                return;
+            }
+            continue;
+        }
+        if (!tm_read(shared, tx, &accounts[from], sizeof(word), &from_balance) ||
+            !tm_read(shared, tx, &accounts[to], sizeof(word), &to_balance))
+        {
+            continue;
+        }
+        amount = from_balance ? 1 + (word)rand_r(seed) % from_balance : 0;
+        from_balance -= amount;
+        to_balance += amount;
+        if (!tm_write(shared, tx, &from_balance, sizeof(word), &accounts[from]) ||
+            !tm_write(shared, tx, &to_balance, sizeof(word), &accounts[to]))
+        {
+            continue;
+        }
+        if (tm_end(shared, tx))
+        {
+            return;
+        }
+    } while (true);
+}
+
+static bool bank_check(shared_t shared, uint64_t committed)
+{
+    bool consistent;
+    tx_t tx;
+
+    (void)committed;
+    do
+    {
+        tx = tm_begin(shared, true);
+    } while (!bank_sum(shared, tx, &consistent) || !tm_end(shared, tx));
+    if (!consistent)
+    {
+        fprintf(stderr, "bank total changed\n");
+    }
+    return consistent;
+}
+
+/* Allocation: records are replaced by fresh ones and freed, their words must always agree */
+
+/* read a record and check that it is whole: its length, then the same value in every other word */
+static bool record_read(shared_t shared, tx_t tx, word const *record, bool *consistent)
+{
+    word words[RECORD_MAX];
+
+    if (!tm_read(shared, tx, record, sizeof(word), words))
+    {
+        return false;
+    }
+    *consistent = words[0] >= 2 && words[0] <= RECORD_MAX;
+    if (!*consistent)
+    {
+        return true;
+    }
+    if (!tm_read(shared, tx, &record[1], (words[0] - 1) * sizeof(word), &words[1]))
+    {
+        return false;
+    }
+    for (uint64_t i = 2; i < words[0]; i++)
+    {
+        *consistent = *consistent && words[i] == words[1];
+    }
+    return true;
+}
+
+/* write a whole record, its length first */
+static bool record_write(shared_t shared, tx_t tx, word *record, word length, word value)
+{
+    for (uint64_t i = 0; i < length; i++)
+    {
+        if (!tm_write(shared, tx, i ? &value : &length, sizeof(word), &record[i]))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool alloc_init(shared_t shared)
+{
+    (void)shared;
+    return true;
+}
+
+static void alloc_op(shared_t shared, unsigned *seed)
+{
+    word *slots = tm_start(shared), *record, *old, length, value;
+    uint64_t slot = (uint64_t)rand_r(seed) % SLOTS;
+    bool replace = rand_r(seed) % 2 == 0, consistent = true;
+    void *allocated;
+    tx_t tx;
+
+    length = 2 + (word)rand_r(seed) % (RECORD_MAX - 1);
+    value = (word)rand_r(seed);
+    do
+    {
+        tx = tm_begin(shared, !replace);
+        if (!tm_read(shared, tx, &slots[slot], sizeof(word), &old))
+        {
+            continue;
+        }
+        if (old && !record_read(shared, tx, old, &consistent))
+        {
+            continue;
+        }
+        if (replace)
+        {
+            switch (tm_alloc(shared, tx, length * sizeof(word), &allocated))
+            {
+            case success_alloc:
+                break;
+            case abort_alloc:
+                continue;
+            default:
+                fprintf(stderr, "out of transactional memory\n");
+                exit(EXIT_FAILURE);
+            }
+            record = allocated;
+            if (!record_write(shared, tx, record, length, value) ||
+                !tm_write(shared, tx, &record, sizeof(word), &slots[slot]) || (old && !tm_free(shared, tx, old)))
+            {
+                continue;
+            }
+        }
+        if (tm_end(shared, tx))
+        {
+            atomic_fetch_add(&inconsistent, !consistent);
+            return;
+        }
+    } while (true);
+}
+
+/* whether every record in the slots is whole, as of one transaction */
+static bool alloc_scan(shared_t shared, tx_t tx, bool *consistent)
+{
+    word *slots = tm_start(shared), *record;
+    bool whole;
+
+    *consistent = true;
+    for (uint64_t i = 0; i < SLOTS; i++)
+    {
+        if (!tm_read(shared, tx, &slots[i], sizeof(word), &record) ||
+            (record && !record_read(shared, tx, record, &whole)))
+        {
+            return false;
+        }
+        *consistent = *consistent && (!record || whole);
+    }
+    return true;
+}
+
+static bool alloc_check(shared_t shared, uint64_t committed)
+{
+    bool consistent;
+    tx_t tx;
+
+    (void)committed;
+    do
+    {
+        tx = tm_begin(shared, true);
+    } while (!alloc_scan(shared, tx, &consistent) || !tm_end(shared, tx));
+    if (!consistent)
+    {
+        fprintf(stderr, "torn record\n");
+    }
+    return consistent;
+}
+
+static test const tests[] = {
+    {"counter", sizeof(word), counter_init, counter_op, counter_check},
+    {"bank", ACCOUNTS * sizeof(word), bank_init, bank_op, bank_check},
+    {"alloc", SLOTS * sizeof(word), alloc_init, alloc_op, alloc_check},
+};
+
+#define TESTS (sizeof(tests) / sizeof(tests[0]))
+
+static void *worker_run(void *arg)
+{
+    worker *w = arg;
+
+    for (uint64_t i = 0; i < transactions; i++)
+    {
+        w->test->op(w->shared, &w->seed);
+    }
+    return NULL;
+}
+
+/* set a setting's variables, after unsetting those of the previous one */
+static void setting_apply(setting const *setting)
+{
+    char variable[64];
+    char const *value;
+
+    for (uint64_t i = 0; variables[i]; i++)
+    {
+        unsetenv(variables[i]);
+    }
+    for (uint64_t i = 0; i < MAX_SETTINGS && setting->env[i]; i++)
+    {
+        value = strchr(setting->env[i], '=');
+        snprintf(variable, sizeof(variable), "%.*s", (int)(value - setting->env[i]), setting->env[i]);
+        setenv(variable, value + 1, 1);
+    }
+}
+
+/* run one test with its own region, return whether its invariants held */
+static bool test_run(test const *test, uint64_t threads)
+{
+    worker workers[MAX_THREADS];
+    shared_t shared;
+    bool passed;
+
+    shared = tm_create(test->size, sizeof(word));
+    if (shared == invalid_shared || !test->init(shared))
+    {
+        fprintf(stderr, "setup failed\n");
+        return false;
+    }
+    atomic_store(&inconsistent, 0);
+    for (uint64_t i = 0; i < threads; i++)
+    {
+        workers[i].shared = shared;
+        workers[i].test = test;
+        workers[i].seed = (unsigned)i + 1;
+        if (pthread_create(&workers[i].thread, NULL, worker_run, &workers[i]) != 0)
+        {
+            perror("pthread_create");
+            exit(EXIT_FAILURE);
+        }
+    }
+    for (uint64_t i = 0; i < threads; i++)
+    {
+        pthread_join(workers[i].thread, NULL);
+    }
+    passed = test->check(shared, threads * transactions);
+    if (atomic_load(&inconsistent))
+    {
+        fprintf(stderr, "%lu transactions saw an inconsistent state\n", atomic_load(&inconsistent));
+        passed = false;
+    }
+    tm_destroy(shared);
+    return passed;
+}
+
+int main(int argc, char **argv)
+{
+    uint64_t threads = DEFAULT_THREADS, failed = 0;
+    bool passed;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "t:n:h")) != -1)
+    {
+        switch (opt)
+        {
+        case 't':
+            threads = strtoull(optarg, NULL, 10);
+            break;
+        case 'n':
+            transactions = strtoull(optarg, NULL, 10);
+            break;
+        default:
+            fprintf(stderr, "usage: %s [-t threads] [-n transactions per thread]\n", argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    if (!threads || threads > MAX_THREADS)
+    {
+        fprintf(stderr, "threads must be between 1 and %d\n", MAX_THREADS);
+        return EXIT_FAILURE;
+    }
+
+    for (uint64_t s = 0; s < SETTINGS; s++)
+    {
+        setting_apply(&settings[s]);
+        for (uint64_t t = 0; t < TESTS; t++)
+        {
+            passed = test_run(&tests[t], threads);
+            printf("%-6s %-22s %s\n", passed ? "ok" : "FAIL", settings[s].name, tests[t].name);
+            fflush(stdout);
+            failed += !passed;
+        }
+    }
+    printf("%lu of %lu failed\n", failed, SETTINGS * TESTS);
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -32,21 +32,41 @@
 #include <string.h>
 
 // Internal headers
+#include "arena.h"
 #include "array.h"
+#include "clock.h"
+#include "cm.h"
+#include "epoch.h"
+#include "config.h"
 #include "handler.h"
-#include "linked_list.h"
+#include "history.h"
 #include "macros.h"
+#include "memory.h"
+#include "profile.h"
 #include "region.h"
+#include "segment.h"
+#include "serial.h"
 #include "sync.h"
 #include "tm.h"
+#include "trace.h"
 #include "utils.h"
 
-static bool ro_read(region *region, handler *handler, void const *src, size_t size, void *dest);
-static bool rw_read(region *region, handler *handler, void const *src, size_t size, void *dest);
-static bool ro_validate(region *region, handler *handler);
-static segment *segment_create(uint16_t index, size_t size, size_t align);
-static bool transaction_validate(region *region, handler *handler);
-static void flush_segment_ll(ll *ll);
+static abort_cause ro_read(region *region, handler *handler, void const *src, size_t size, void *dest);
+static abort_cause rw_read(region *region, handler *handler, void const *src, size_t size, void *dest);
+static bool snapshot_extend(region *region, handler *handler);
+static uint64_t bulk_read(region *region, segment *segment, void const *src, uint64_t n_words,
+                          void *dest, uint64_t timestamp);
+static void ro_log_reads(region *region, handler *handler, segment *segment, void const *src, uint64_t first,
+                         uint64_t last);
+static void write_back(region *region, write_entry *write);
+static void rw_log_read(region *region, handler *handler, segment *segment, void const *word, void *dest,
+                        vlock **logged);
+static void private_copy(region *region, segment *segment, void *opaque, void *private, size_t size,
+                         bool store);
+static void const *locked_word(region *region, handler *handler, vlock *vlock);
+static abort_cause transaction_validate(region *region, handler *handler);
+static void transaction_commit(region *region, handler *handler);
+static void transaction_abort(region *region, handler *handler, abort_cause cause);
 
 /** Create (i.e. allocate + init) a new shared memory region, with one first non-free-able allocated segment of the requested size and alignment.
  * @param size  Size of the first shared segment of memory to allocate (in bytes), must be a positive multiple of the alignment
@@ -73,7 +93,7 @@ shared_t tm_create(size_t size, size_t align)
 
     struct memory_region *region;
 
-    region = malloc(sizeof(struct memory_region));
+    region = aligned_alloc(CACHE_LINE, sizeof(struct memory_region));
     if (unlikely(!region))
     {
         perror("malloc");
@@ -82,40 +102,57 @@ shared_t tm_create(size_t size, size_t align)
     }
 
     region->alignment = align;
+    config_load(&region->config, align);
     region->clock = 0;
-    region->next_handler = 0;
-    region->segment_count = 1;
-    region->next_segment = 1;
-    region->segment_lock = false;
+    region->segment_count = 0;
+    region->next_segment = 0;
+    region->free_indices = 0;
+    for (uint64_t i = 0; i < POOL_CLASSES; i++)
+    {
+        region->pool[i] = 0;
+        region->pool_size[i] = 0;
+    }
 
-    region->segments = malloc(sizeof(struct memory_segment *) * MAX_SEGMENTS);
-    if (!region->segments)
+    region->orecs = NULL;
+    if (region->config.vlocks == VLOCKS_STRIPED)
     {
-        perror("malloc");
-        traceerror();
-        return invalid_shared;
+        region->orecs = memory_alloc(region, sizeof(vlock) << region->config.stripe_bits, CACHE_LINE);
+        if (!region->orecs)
+        {
+            traceerror();
+            return invalid_shared;
+        }
     }
 
-    region->alloced_list = ll_create();
-    if (!region->alloced_list)
+    /* sized for every index and thread slot, but only the pages in use are ever backed */
+    region->segments = memory_reserve(sizeof(struct memory_segment *) * MAX_SEGMENTS);
+    region->next_free = memory_reserve(sizeof(atomic_ushort) * MAX_SEGMENTS);
+    region->threads = memory_reserve(sizeof(struct region_thread) * MAX_THREADS);
+    if (!region->segments || !region->next_free || !region->threads)
     {
         traceerror();
         return invalid_shared;
     }
+    region->epoch = 1;
+    region->irrevocable = 0;
+    region->watermark = 0;
+    trace_init(region);
 
-    region->freed_list = ll_create();
-    if (!region->freed_list)
+    region->profile = NULL;
+    if (region->config.profile_period)
     {
-        traceerror();
-        return invalid_shared;
+        region->profile = profile_create();
+        if (!region->profile)
+        {
+            traceerror();
+            return invalid_shared;
+        }
     }
-    region->segments[0] = segment_create(0, size, align);
-    if (!region->freed_list)
+    if (!segment_alloc(region, NULL, size))
     {
         traceerror();
         return invalid_shared;
     }
-    ll_tail_push(region->alloced_list, region->segments[0]);
     return region;
 }
 
@@ -125,11 +162,15 @@ shared_t tm_create(size_t size, size_t align)
 void tm_destroy(shared_t shared)
 {
     struct memory_region *region = (struct memory_region *)shared;
-    flush_segment_ll(region->freed_list);
-    flush_segment_ll(region->alloced_list);
-    free(region->alloced_list);
-    free(region->freed_list);
-    free(region->segments);
+    trace_destroy(region);
+    profile_destroy(region);
+    epoch_drain(region);
+    segment_destroy_all(region);
+    history_drain(region);
+    memory_unreserve(region->segments, sizeof(struct memory_segment *) * MAX_SEGMENTS);
+    memory_unreserve(region->next_free, sizeof(atomic_ushort) * MAX_SEGMENTS);
+    memory_unreserve(region->threads, sizeof(struct region_thread) * MAX_THREADS);
+    memory_free(region, region->orecs, sizeof(vlock) << region->config.stripe_bits, CACHE_LINE);
     free(region);
 }
 
@@ -169,19 +210,34 @@ tx_t tm_begin(shared_t shared, bool is_ro)
 {
     struct transaction_handler *handler;
 
-    handler = malloc(sizeof(struct transaction_handler));
+    /* descriptor and its read/write sets are reused across transactions */
+    handler = handler_get();
     if (unlikely(!handler))
     {
-        perror("malloc");
         traceerror();
         return invalid_tx;
     }
 
-    handler->id = atomic_fetch_add(&((region *)shared)->next_handler, 1);
     handler->is_ro = is_ro;
-    handler->timestamp = atomic_load(&((struct memory_region *)shared)->clock);
-    handler->r_set = array_init_size(INIT_RSET_SIZE);
-    handler->w_set = array_init_size(INIT_WSET_SIZE);
+    cm_begin((struct memory_region *)shared, handler);
+
+    /* starving transactions stop competing and run alone, the others wait for them at begin */
+    handler->irrevocable = ((region *)shared)->config.irrevocable_after &&
+                           handler->aborts >= ((region *)shared)->config.irrevocable_after;
+    if (unlikely(handler->irrevocable))
+    {
+        serial_begin((struct memory_region *)shared, handler);
+    }
+    else
+    {
+        serial_enter((struct memory_region *)shared, handler);
+    }
+    if (is_ro && ((region *)shared)->config.versions)
+    {
+        history_enter((struct memory_region *)shared, handler);
+    }
+    handler->timestamp = clock_read((struct memory_region *)shared);
+    trace_event((struct memory_region *)shared, handler, TRACE_BEGIN, is_ro);
 
     return (tx_t)handler;
 }
@@ -193,15 +249,30 @@ tx_t tm_begin(shared_t shared, bool is_ro)
  **/
 bool tm_end(shared_t shared, tx_t tx)
 {
+    /* nothing ran alongside, and its writes are already in place */
+    if (unlikely(((struct transaction_handler *)tx)->irrevocable))
+    {
+        transaction_commit((struct memory_region *)shared, (struct transaction_handler *)tx);
+        serial_end((struct memory_region *)shared);
+        return true;
+    }
+
     if (((struct transaction_handler *)tx)->is_ro)
     {
-        handler_reset((struct transaction_handler *)tx, false);
+        transaction_commit((struct memory_region *)shared, (struct transaction_handler *)tx);
         return true;
     }
 
-    bool commit = transaction_validate((struct memory_region *)shared, (struct transaction_handler *)tx);
-    handler_reset((struct transaction_handler *)tx, false);
-    return commit;
+    trace_event((struct memory_region *)shared, (struct transaction_handler *)tx, TRACE_VALIDATE, 0);
+    abort_cause cause = transaction_validate((struct memory_region *)shared, (struct transaction_handler *)tx);
+    trace_event((struct memory_region *)shared, (struct transaction_handler *)tx, TRACE_VALIDATED, cause);
+    if (cause != ABORT_NONE)
+    {
+        transaction_abort((struct memory_region *)shared, (struct transaction_handler *)tx, cause);
+        return false;
+    }
+    transaction_commit((struct memory_region *)shared, (struct transaction_handler *)tx);
+    return true;
 }
 
 /** [thread-safe] Read operation in the given transaction, source in the shared region and target in a private region.
@@ -214,22 +285,42 @@ bool tm_end(shared_t shared, tx_t tx)
  **/
 bool tm_read(shared_t shared, tx_t tx, void const *source, size_t size, void *target)
 {
-    bool success;
+    struct memory_region *region;
+    segment *segment;
+    abort_cause cause;
+
+    /* segments allocated by this transaction are invisible to others until it commits, */
+    /* and an irrevocable transaction has the whole region to itself                     */
+    region = (struct memory_region *)shared;
+    trace_event(region, (struct transaction_handler *)tx, TRACE_READ, size / region->alignment);
+    segment = region->segments[indexof(source)];
+    if (atomic_load_explicit(&segment->owner, memory_order_relaxed) == (void *)tx ||
+        ((struct transaction_handler *)tx)->irrevocable)
+    {
+        private_copy(region, segment, (void *)source, target, size, false);
+        return true;
+    }
+    if (region->config.adapt_words && !(((struct transaction_handler *)tx)->accesses++ & (ADAPT_PERIOD - 1)))
+    {
+        segment_adapt(region, (struct transaction_handler *)tx, segment, size / region->alignment);
+    }
+
     if (((struct transaction_handler *)tx)->is_ro)
     {
-        success = ro_read((struct memory_region *)shared, (struct transaction_handler *)tx,
-                          source, size, target);
+        cause = ro_read((struct memory_region *)shared, (struct transaction_handler *)tx,
+                        source, size, target);
     }
     else
     {
-        success = rw_read((struct memory_region *)shared, (struct transaction_handler *)tx,
-                          source, size, target);
+        cause = rw_read((struct memory_region *)shared, (struct transaction_handler *)tx,
+                        source, size, target);
     }
-    if (!success)
+    if (cause != ABORT_NONE)
     {
-        handler_reset((struct transaction_handler *)tx, true);
+        transaction_abort((struct memory_region *)shared, (struct transaction_handler *)tx, cause);
+        return false;
     }
-    return success;
+    return true;
 }
 
 /** [thread-safe] Write operation in the given transaction, source in a private region and target in the shared region.
@@ -244,20 +335,29 @@ bool tm_write(shared_t shared, tx_t tx, void const *source, size_t size, void *t
 {
     struct memory_region *region;
     struct transaction_handler *handler;
-    uint64_t n_words;
-    void *tmp, *offset_src, *offset_dest;
+    segment *segment;
 
     region = (struct memory_region *)shared;
     handler = (struct transaction_handler *)tx;
+    trace_event(region, handler, TRACE_WRITE, size / region->alignment);
 
-    n_words = size / region->alignment;
-    for (uint64_t i = 0; i < n_words; i++)
+    segment = region->segments[indexof(target)];
+    if (atomic_load_explicit(&segment->owner, memory_order_relaxed) == handler || handler->irrevocable)
+    {
+        private_copy(region, segment, target, (void *)source, size, true);
+        return true;
+    }
+
+    if (region->config.adapt_words && !(handler->accesses++ & (ADAPT_PERIOD - 1)))
+    {
+        segment_adapt(region, handler, segment, size / region->alignment);
+    }
+
+    /* contiguous words are logged as one record, written back with one copy at commit */
+    if (unlikely(!handler_add_write(handler, source, target, size, region->alignment)))
     {
-        offset_src = &((char *)source)[i * region->alignment];
-        offset_dest = &((char *)target)[i * region->alignment];
-        tmp = malloc(region->alignment);
-        memcpy(tmp, offset_src, region->alignment);
-        handler_add_write(handler, tmp, offset_dest, size);
+        transaction_abort(region, handler, ABORT_NOMEM);
+        return false;
     }
     return true;
 }
@@ -269,46 +369,36 @@ bool tm_write(shared_t shared, tx_t tx, void const *source, size_t size, void *t
  * @param target Pointer in private memory receiving the address of the first byte of the newly allocated, aligned segment
  * @return Whether the whole transaction can continue (success/nomem), or not (abort_alloc)
  **/
-alloc_t tm_alloc(shared_t shared, tx_t unused(tx), size_t size, void **target)
+alloc_t tm_alloc(shared_t shared, tx_t tx, size_t size, void **target)
 {
     struct memory_region *region;
+    struct transaction_handler *handler;
     segment *segment;
-    uint64_t segment_index;
     region = (struct memory_region *)shared;
+    handler = (struct transaction_handler *)tx;
 
-    segment_index = atomic_fetch_add(&region->next_segment, 1);
-    if (unlikely(segment_index >= MAX_SEGMENTS))
-    {
-        fprintf(stderr, "warning: max segments %d exceeded\n", MAX_SEGMENTS);
-        return nomem_alloc;
-    }
-
-    segment = segment_create(segment_index, size, region->alignment);
+    /* recycled from this thread's aborted allocations or the segment's size class when possible */
+    segment = segment_alloc(region, &region->threads[handler->slot], size);
     if (unlikely(!segment))
     {
         return nomem_alloc;
     }
 
-    if (unlikely(!bounded_spinlock_acquire(&region->segment_lock)))
+    /* accessed without metadata until published at commit */
+    atomic_store_explicit(&segment->owner, handler, memory_order_relaxed);
+    if (unlikely(!array_add(&handler->allocs, segment)))
     {
-        free(segment->vaddr);
-        free(segment);
+        /* aborting only gives back the logged allocations, and an irrevocable transaction cannot abort */
+        segment_uncommit(region, &region->threads[handler->slot], segment);
+        if (handler->irrevocable)
+        {
+            return nomem_alloc;
+        }
+        transaction_abort(region, handler, ABORT_NOMEM);
         return abort_alloc;
     }
 
-    /* free marked segments before allocating new */
-    flush_segment_ll(region->freed_list);
-
-    ll_tail_push(region->alloced_list, segment);
-    region->segments[segment_index] = segment;
-
-    if (unlikely(!lock_release(&region->segment_lock)))
-    {
-        traceerror();
-    }
-
-    atomic_fetch_add(&region->segment_count, 1);
-    *target = opaqueof(segment->vaddr, segment_index);
+    *target = opaqueof(segment->vaddr, segment->index);
     return success_alloc;
 }
 
@@ -318,7 +408,7 @@ alloc_t tm_alloc(shared_t shared, tx_t unused(tx), size_t size, void **target)
  * @param target Address of the first byte of the previously allocated segment to deallocate
  * @return Whether the whole transaction can continue
  **/
-bool tm_free(shared_t shared, tx_t unused(tx), void *target)
+bool tm_free(shared_t shared, tx_t tx, void *target)
 {
     struct memory_region *region;
     segment *segment;
@@ -326,263 +416,576 @@ bool tm_free(shared_t shared, tx_t unused(tx), void *target)
     region = (struct memory_region *)shared;
     segment = region->segments[indexof(target)];
 
-    if (unlikely(!bounded_spinlock_acquire(&region->segment_lock)))
-    {
-        return false;
-    }
-
-    /* make sure it's safe that multiple transactions free the same segment */
-    if (likely(ll_remove(region->alloced_list, segment)))
-    {
-        ll_tail_push(region->freed_list, segment);
-    }
-
-    if (unlikely(!lock_release(&region->segment_lock)))
-    {
-        traceerror();
-    }
-
+    /* takes effect at commit, a free that cannot be logged only leaks the segment */
+    array_add(&((struct transaction_handler *)tx)->frees, segment);
     return true;
 }
 
-bool ro_read(region *region, handler *handler, void const *src, size_t size, void *dest)
+abort_cause ro_read(region *region, handler *handler, void const *src, size_t size, void *dest)
 {
     segment *segment;
-    void *src_vaddr, *offset_src, *offset_dest;
-    uint64_t n_words, word_index, timestamp, attempts = 0;
+    vlock *word_vlock;
+    void const *word;
+    void *offset_src, *offset_dest;
+    uint64_t n_words, valid, i = 0, attempts = 0;
+    bool old;
 
     segment = region->segments[indexof(src)];
-    src_vaddr = vaddrof(src, segment->vaddr_base);
 
     n_words = size / region->alignment;
-    for (uint64_t i = 0; i < n_words; i++)
+    while (i < n_words)
     {
-        offset_src = &(((char *)src_vaddr)[i * region->alignment]);
-        offset_dest = &(((char *)dest)[i * region->alignment]);
-        memcpy(offset_dest, offset_src, region->alignment);
+        /* copy and check the rest of the range at once, up to its first conflicting word */
+        valid = i + bulk_read(region, segment, &((char *)src)[i * region->alignment], n_words - i,
+                              &((char *)dest)[i * region->alignment], handler->timestamp);
+        ro_log_reads(region, handler, segment, src, i, valid);
+        i = valid;
+        if (i == n_words)
+        {
+            break;
+        }
 
-        word_index = (offset_src - segment->vaddr) / region->alignment;
+        word = &((char *)src)[i * region->alignment];
+        offset_src = getword(region, segment, word);
+        offset_dest = &(((char *)dest)[i * region->alignment]);
+        word_vlock = getvlock(region, segment, word);
 
-        /* without ro optimization */
-        // if (!vlock_unlocked_old(&segment->vlocks[word_index], handler->timestamp))
-        // {
-        //     return false;
-        // }
+        /* the value as of the snapshot, if kept, is as good as a current one, */
+        /* but the snapshot can no longer move past an overwritten value       */
+        if (region->config.versions && history_read(region, segment, word, handler->timestamp, offset_dest, &old))
+        {
+            if (old)
+            {
+                handler->r_overflow = true;
+            }
+            else
+            {
+                ro_log_reads(region, handler, segment, src, i, i + 1);
+            }
+            i++;
+            continue;
+        }
 
         /* is the word currently being locked by a different transaction?    */
         /* has the word been updated since this transaction started?         */
-        while (!vlock_unlocked_old(&segment->vlocks[word_index], handler->timestamp))
+        /* did a write-back overlap the copy?                                */
+        while (!vlock_read(word_vlock, offset_src, offset_dest, region->alignment, handler->timestamp))
         {
-            timestamp = atomic_load(&region->clock);
-            if (!ro_validate(region, handler))
+            clock_observe(region, getversion(atomic_load(word_vlock)));
+            /* invisible reads validate against the start timestamp only */
+            if (!region->config.ro_extend || handler->r_overflow)
+            {
+                handler->conflict = word;
+                return ABORT_READ_CONFLICT;
+            }
+
+            if (!snapshot_extend(region, handler))
             {
-                // printf("%s(): tx %08ld | abort by read set validation\n", __FUNCTION__, handler->id);
-                return false;
+                return ABORT_EXTEND;
             }
-            handler->timestamp = timestamp;
-            memcpy(offset_dest, offset_src, region->alignment);
             if (++attempts == RO_VALIDATE_ATTEMPTS)
             {
-                // printf("%s(): tx %08ld | abort by exceeded attempts\n", __FUNCTION__, handler->id);
-                return false;
+                handler->conflict = word;
+                return ABORT_READ_ATTEMPTS;
             }
         }
-        handler_add_read(handler, &((char *)src)[i * region->alignment]);
+        ro_log_reads(region, handler, segment, src, i, i + 1);
+        i++;
     }
-    return true;
+    return ABORT_NONE;
 }
 
-bool rw_read(region *region, handler *handler, void const *src, size_t size, void *dest)
+abort_cause rw_read(region *region, handler *handler, void const *src, size_t size, void *dest)
 {
     segment *segment;
-    write_entry *write;
-    uint64_t n_words, word_index;
-    void *src_vaddr, *offset_src, *offset_dest;
+    void *written;
+    vlock *word_vlock, *logged = NULL;
+    uint64_t n_words, valid, i = 0, attempts = 0;
+    void const *word;
+    void *offset_src, *offset_dest;
 
     segment = region->segments[indexof(src)];
-    src_vaddr = vaddrof(src, segment->vaddr_base);
 
     n_words = size / region->alignment;
-    for (uint64_t i = 0; i < n_words; i++)
+    while (i < n_words)
     {
-        offset_src = &((char *)src_vaddr)[i * region->alignment];
+        /* copy and check the rest of the range at once, up to its first conflicting word */
+        valid = i + bulk_read(region, segment, &((char *)src)[i * region->alignment], n_words - i,
+                              &((char *)dest)[i * region->alignment], handler->timestamp);
+        for (; i < valid; i++)
+        {
+            rw_log_read(region, handler, segment, &((char *)src)[i * region->alignment],
+                        &((char *)dest)[i * region->alignment], &logged);
+        }
+        if (i == n_words)
+        {
+            break;
+        }
+
+        /* in case of a write before read in the same transaction */
+        word = &((char *)src)[i * region->alignment];
         offset_dest = &((char *)dest)[i * region->alignment];
+        written = handler_get_write(handler, word);
+        if (written)
+        {
+            memcpy(offset_dest, written, region->alignment);
+            i++;
+            continue;
+        }
 
-        word_index = ((void *)&((char *)src_vaddr)[i * region->alignment] - segment->vaddr) /
-                     region->alignment;
+        offset_src = getword(region, segment, word);
 
         /* is the word currently being locked by a different transaction?    */
         /* has the word been updated since this transaction started?         */
-        if (!vlock_unlocked_old(&segment->vlocks[word_index], handler->timestamp))
+        /* did a write-back overlap the copy?                                */
+        word_vlock = getvlock(region, segment, word);
+        while (!vlock_read(word_vlock, offset_src, offset_dest, region->alignment, handler->timestamp))
         {
-            return false;
-        }
-        /* in case of a write before read in the same transaction */
-        write = in_write_set(handler->w_set, src);
-        if (write)
-        {
-            offset_src = vaddrof(write->src, segment->vaddr_base);
-            memcpy(offset_dest, offset_src, region->alignment);
-            continue;
+            clock_observe(region, getversion(atomic_load(word_vlock)));
+            if (!region->config.rw_extend)
+            {
+                handler->conflict = word;
+                return ABORT_READ_CONFLICT;
+            }
+            if (!snapshot_extend(region, handler))
+            {
+                return ABORT_EXTEND;
+            }
+            if (++attempts == RO_VALIDATE_ATTEMPTS)
+            {
+                handler->conflict = word;
+                return ABORT_READ_ATTEMPTS;
+            }
         }
-        handler_add_read(handler, &((char *)src)[i * region->alignment]);
-        memcpy(offset_dest, offset_src, region->alignment);
+        handler_add_read(handler, (void *)word);
+        logged = word_vlock;
+        i++;
     }
-    return true;
+    return ABORT_NONE;
 }
 
-static bool ro_validate(region *region, handler *handler)
+/** Copy a range of words out of a segment, many words per copy, with their vlocks loaded around each copy.
+ * Vlocks are loaded before a copy, which stops short of the first one locked or newer than the timestamp,
+ * and again after it: writers lock before writing back, so words whose vlock kept its value were not written.
+ * @return Number of leading words read consistently, n_words if all of them
+ **/
+static uint64_t bulk_read(region *region, segment *segment, void const *src, uint64_t n_words,
+                          void *dest, uint64_t timestamp)
 {
-    segment *segment;
-    void *src;
-    uint64_t vlock_timestamp, word_index;
-    for (uint64_t i = 0; i < handler->r_set->size; i++)
-    {
-        src = arrayget(handler->r_set, i);
-        segment = region->segments[indexof(src)];
-        word_index = (vaddrof(src, segment->vaddr_base) - segment->vaddr) / region->alignment;
+    vlock *stripes[BULK_CHUNK];
+    uint64_t versions[BULK_CHUNK], ends[BULK_CHUNK];
+    segment_meta *meta;
+    uint64_t valid, span, start, first, n, passed, changed, end;
+    void const *word;
 
-        /* if word is outdated */
-        vlock_timestamp = atomic_load(&segment->vlocks[word_index]);
-        /* locked bit is MSB and we therefore check for both version and if-locked */
-        /* if (word is newer than recorded timestamp) OR (word is locked) */
-        if (vlock_timestamp > handler->timestamp)
+    switch (region->config.vlocks)
+    {
+    case VLOCKS_INTERLEAVED:
+        /* data is contiguous within a block, which a single vlock guards */
+        for (valid = 0; valid < n_words; valid += span)
         {
-            return false;
+            word = &((char *)src)[valid * region->alignment];
+            span = region->config.block_words - wordindex(region, segment, word) % region->config.block_words;
+            span = span < n_words - valid ? span : n_words - valid;
+            if (!vlock_read(getvlock(region, segment, word), getword(region, segment, word),
+                            &((char *)dest)[valid * region->alignment], span * region->alignment, timestamp))
+            {
+                return valid;
+            }
+        }
+        return n_words;
+    case VLOCKS_STRIPED:
+        /* neighbouring words mostly share a stripe, each stripe's vlock is loaded once */
+        for (valid = 0; valid < n_words; valid = ends[n - 1])
+        {
+            for (n = 0, end = valid; end < n_words && n < BULK_CHUNK; n++)
+            {
+                word = &((char *)src)[end * region->alignment];
+                stripes[n] = getvlock(region, segment, word);
+                end = ((((uint64_t)word >> region->config.stripe_shift) + 1) << region->config.stripe_shift) -
+                      (uint64_t)src;
+                end /= region->alignment;
+                ends[n] = end = end < n_words ? end : n_words;
+            }
+            for (passed = 0; passed < n; passed++)
+            {
+                versions[passed] = atomic_load_explicit(stripes[passed], memory_order_acquire);
+                if (versions[passed] > timestamp)
+                {
+                    break;
+                }
+            }
+            if (!passed)
+            {
+                return valid;
+            }
+            memcpy(&((char *)dest)[valid * region->alignment],
+                   getword(region, segment, &((char *)src)[valid * region->alignment]),
+                   (ends[passed - 1] - valid) * region->alignment);
+            atomic_thread_fence(memory_order_acquire);
+            for (changed = 0; changed < passed; changed++)
+            {
+                if (atomic_load_explicit(stripes[changed], memory_order_relaxed) != versions[changed])
+                {
+                    return changed ? ends[changed - 1] : valid;
+                }
+            }
+            if (passed < n)
+            {
+                return ends[passed - 1];
+            }
+        }
+        return n_words;
+    default:
+        /* contiguous vlocks, each guarding 2^grain words, the first may guard words before the range */
+        meta = atomic_load_explicit(&segment->meta, memory_order_acquire);
+        start = wordindex(region, segment, src);
+        for (valid = 0; valid < n_words; valid = end)
+        {
+            first = (start + valid) >> meta->grain;
+            n = ((start + n_words - 1) >> meta->grain) + 1 - first;
+            n = n < BULK_CHUNK ? n : BULK_CHUNK;
+            passed = snapshot_vlocks(&meta->vlocks[first], n, timestamp, versions);
+            if (!passed)
+            {
+                return valid;
+            }
+            end = ((first + passed) << meta->grain) - start;
+            end = end < n_words ? end : n_words;
+            memcpy(&((char *)dest)[valid * region->alignment],
+                   getword(region, segment, &((char *)src)[valid * region->alignment]),
+                   (end - valid) * region->alignment);
+            atomic_thread_fence(memory_order_acquire);
+            changed = recheck_vlocks(&meta->vlocks[first], passed, versions);
+            if (changed < passed)
+            {
+                return changed ? ((first + changed) << meta->grain) - start : valid;
+            }
+            if (passed < n)
+            {
+                return end;
+            }
         }
+        return n_words;
     }
-    return true;
 }
 
-segment *segment_create(uint16_t index, size_t size, size_t align)
+/** Log a word read by an update transaction, or serve it from the write log if already written.
+ * Vlocks only get coarser, so words sharing a vlock now share one at validation: the first is logged.
+ * @param logged Vlock of the last word logged by the caller, updated
+ **/
+static void rw_log_read(region *region, handler *handler, segment *segment, void const *word, void *dest,
+                        vlock **logged)
 {
-    segment *segment;
-    segment = malloc(sizeof(struct memory_segment));
-    if (unlikely(!segment))
+    vlock *word_vlock;
+    void *written = handler_get_write(handler, word);
+    if (written)
     {
-        perror("malloc");
-        traceerror();
-        return NULL;
+        memcpy(dest, written, region->alignment);
+        return;
     }
-
-    segment->vaddr = aligned_alloc(align, size);
-    if (unlikely(!segment->vaddr))
+    word_vlock = getvlock(region, segment, word);
+    if (word_vlock != *logged)
     {
-        perror("malloc");
-        traceerror();
-        return NULL;
+        handler_add_read(handler, (void *)word);
+        *logged = word_vlock;
     }
-    bzero(segment->vaddr, size);
+}
 
-    segment->index = index;
-    segment->length = size / align;
-    segment->vaddr_base = baseof(segment->vaddr);
+/* reads are only logged to support snapshot extension, and only up to a bound */
+static void ro_log_reads(region *region, handler *handler, segment *segment, void const *src, uint64_t first,
+                         uint64_t last)
+{
+    vlock *word_vlock, *logged = NULL;
+    void const *word;
 
-    segment->vlocks = calloc(sizeof(vlock), segment->length);
-    if (unlikely(!segment->vlocks))
+    if (!region->config.ro_extend)
     {
-        perror("malloc");
-        traceerror();
-        return NULL;
+        return;
+    }
+    for (uint64_t i = first; i < last && !handler->r_overflow; i++)
+    {
+        /* one entry per vlock, as in rw_log_read() */
+        word = &((char *)src)[i * region->alignment];
+        word_vlock = getvlock(region, segment, word);
+        if (word_vlock == logged)
+        {
+            continue;
+        }
+        if (handler->r_set->size < region->config.ro_log_bound)
+        {
+            handler_add_read(handler, (void *)word);
+            logged = word_vlock;
+        }
+        else
+        {
+            handler->r_overflow = true;
+        }
     }
-
-    return segment;
 }
 
-void flush_segment_ll(ll *ll)
+/* move the snapshot to the current clock if every logged read is still valid */
+static bool snapshot_extend(region *region, handler *handler)
 {
-    entry *e;
-    while (ll_length(ll) > 0)
+    segment *segment;
+    void *src;
+    uint64_t vlock_timestamp, timestamp;
+
+    stat_add(region->threads[handler->slot].stats.validations, 1);
+    timestamp = clock_read(region);
+    for (uint64_t i = 0; i < handler->r_set->size; i++)
     {
-        e = ll->head;
-        free(((struct memory_segment *)e->data)->vaddr);
-        free(((struct memory_segment *)e->data)->vlocks);
-        ll_entry_destroy(ll, e);
+        src = arrayget(handler->r_set, i);
+        segment = region->segments[indexof(src)];
+
+        /* if word is outdated */
+        vlock_timestamp = atomic_load(getvlock(region, segment, src));
+        /* locked bit is MSB and we therefore check for both version and if-locked */
+        /* if (word is newer than recorded timestamp) OR (word is locked) */
+        if (vlock_timestamp > handler->timestamp)
+        {
+            handler->conflict = src;
+            return false;
+        }
     }
+    handler->timestamp = timestamp;
+    stat_add(region->threads[handler->slot].stats.extensions, 1);
+    return true;
 }
 
-bool transaction_validate(region *region, handler *handler)
+abort_cause transaction_validate(region *region, handler *handler)
 {
     array *locked;
     segment *segment;
     write_entry *write;
-    vlock *word_vlock;
-    void *dest, *src;
-    uint64_t vlock_timestamp, word_index, write_version;
-
-    locked = array_init_size(INIT_WSET_SIZE);
+    vlock *word_vlock, *previous;
+    void *src;
+    uint64_t vlock_timestamp, write_version, snapshot;
+    bool validate;
 
-    /* lock write set */
-    for (uint64_t i = 0; i < handler->w_set->size; i++)
+    /* nodes for the values this commit overwrites, allocated before any lock is held */
+    if (region->config.versions && unlikely(!history_reserve(region, handler, handler->w_index->size)))
     {
-        dest = ((write_entry *)arrayget(handler->w_set, i))->dest;
-        segment = region->segments[indexof(dest)];
+        return ABORT_NOMEM;
+    }
 
-        word_index = (vaddrof(dest, segment->vaddr_base) - segment->vaddr) / region->alignment;
-        word_vlock = &segment->vlocks[word_index];
+    locked = handler->locks;
+    array_clear(locked);
 
-        if (in_set(locked, word_vlock))
+    /* collect the locks covering the write set, once per run of words sharing one */
+    for (write = wlog_first(handler->w_log); write < wlog_end(handler->w_log); write = wlog_next(write))
+    {
+        segment = region->segments[indexof(write->dest)];
+        previous = NULL;
+        for (uint64_t offset = 0; offset < write->size; offset += region->alignment)
         {
-            continue;
+            word_vlock = getvlock(region, segment, (char *)write->dest + offset);
+            if (word_vlock != previous)
+            {
+                array_add(&locked, word_vlock);
+                previous = word_vlock;
+            }
         }
+    }
+    handler->locks = locked;
 
-        if (!vlock_bounded_spinlock_acquire(word_vlock))
+    /* acquire each lock once, in address order, so that writers never wait on each other in a cycle */
+    sort_vlocks(locked);
+    for (uint64_t i = 0; i < locked->size; i++)
+    {
+        for (uint64_t attempt = 0; !vlock_try_acquire(arrayget(locked, i), &snapshot, handler->slot); attempt++)
         {
-            /* unlock write set and abort transaction */
-            // printf("%s(): tx %08ld | abort by spinlock acquisition\n", __FUNCTION__, handler->id);
-            release_vlocks(locked);
-            array_destroy(locked);
-            return false;
+            /* the contention manager decides between waiting for the owner and aborting, */
+            /* retired vlocks are never released and were replaced by coarser ones        */
+            if (locked(snapshot) &&
+                (getowner(snapshot) == VLOCK_RETIRED || !cm_wait(region, handler, getowner(snapshot), attempt)))
+            {
+                /* unlock write set and abort transaction */
+                release_vlocks(locked, i);
+                handler->conflict = region->profile ? locked_word(region, handler, arrayget(locked, i)) : NULL;
+                return ABORT_LOCK;
+            }
+            cm_pause(attempt);
         }
-        array_add(&locked, word_vlock);
     }
+    trace_event(region, handler, TRACE_LOCKED, locked->size);
 
-    write_version = atomic_fetch_add(&region->clock, 1) + 1; /* inc-and-fetch */
+    write_version = clock_commit(region, handler->timestamp, &validate);
 
-    /* validate read set */
-    if (write_version > handler->timestamp + 1) /* if write_version = handler->timestamp + 1 means no thread    */
-                                                /* incremented the global clock since this transaction started  */
+    /* validate read set, unless the clock shows no commit since this transaction started */
+    if (validate)
     {
+        stat_add(region->threads[handler->slot].stats.validations, 1);
         for (uint64_t i = 0; i < handler->r_set->size; i++)
         {
             src = arrayget(handler->r_set, i);
             segment = region->segments[indexof(src)];
-            word_index = (vaddrof(src, segment->vaddr_base) - segment->vaddr) / region->alignment;
-            word_vlock = &segment->vlocks[word_index];
+            word_vlock = getvlock(region, segment, src);
 
             /* if word is outdated */
             vlock_timestamp = atomic_load(word_vlock);
             if (getversion(vlock_timestamp) > handler->timestamp)
             {
-                // printf("%s(): tx %08ld | abort by read set validation (outdated reads)\n", __FUNCTION__, handler->id);
-                release_vlocks(locked);
-                array_destroy(locked);
-                return false;
+                clock_observe(region, getversion(vlock_timestamp));
+                release_vlocks(locked, locked->size);
+                handler->conflict = src;
+                return ABORT_VALIDATE_OUTDATED;
             }
 
             /* if word is locked in validation of a different transaction */
-            if (locked(vlock_timestamp) && !in_set(locked, word_vlock))
+            if (locked(vlock_timestamp) && getowner(vlock_timestamp) != handler->slot)
             {
-                // printf("%s(): tx %08ld | abort by read set validation (word %ld locked in different transaction)\n", __FUNCTION__, handler->id, word_index);
-                release_vlocks(locked);
-                array_destroy(locked);
-                return false;
+                release_vlocks(locked, locked->size);
+                handler->conflict = src;
+                return ABORT_VALIDATE_LOCKED;
             }
         }
     }
 
-    /* store write set word-by-word */
-    for (uint64_t i = 0; i < handler->w_set->size; i++)
+    /* keep the values about to be overwritten for read-only snapshots older than this commit */
+    if (region->config.versions)
+    {
+        history_record(region, handler, write_version);
+    }
+
+    /* store write set, one copy per contiguous run */
+    for (write = wlog_first(handler->w_log); write < wlog_end(handler->w_log); write = wlog_next(write))
+    {
+        write_back(region, write);
+    }
+
+    /* publish the new version and unlock in one store per lock */
+    commit_vlocks(locked, write_version);
+    return ABORT_NONE;
+}
+
+/* first word of the write set guarded by a vlock, lock failures only know the vlock */
+static void const *locked_word(region *region, handler *handler, vlock *vlock)
+{
+    segment *segment;
+
+    for (write_entry *write = wlog_first(handler->w_log); write < wlog_end(handler->w_log); write = wlog_next(write))
     {
-        write = arrayget(handler->w_set, i);
         segment = region->segments[indexof(write->dest)];
-        word_index = (vaddrof(write->dest, segment->vaddr_base) - segment->vaddr) / region->alignment;
-        memcpy(vaddrof(write->dest, segment->vaddr_base), write->src, write->size);
-        free(write->src);
-        vlock_update(&segment->vlocks[word_index], write_version);
+        for (uint64_t offset = 0; offset < write->size; offset += region->alignment)
+        {
+            if (getvlock(region, segment, (char *)write->dest + offset) == vlock)
+            {
+                return (char *)write->dest + offset;
+            }
+        }
     }
+    return NULL;
+}
 
-    release_vlocks(locked);
-    array_destroy(locked);
-    return true;
+void transaction_commit(region *region, handler *handler)
+{
+    thread_stats *stats = &region->threads[handler->slot].stats;
+    segment *segment;
+
+    stat_add(stats->commits, 1);
+    stat_add(stats->ro_commits, handler->is_ro);
+    stat_add(stats->irrevocable, handler->irrevocable);
+    stat_add(stats->reads, handler->r_set->size);
+    stat_add(stats->writes, handler->w_index->size);
+    stat_max(stats->max_reads, handler->r_set->size);
+    stat_max(stats->max_writes, handler->w_index->size);
+
+    for (uint64_t i = 0; i < handler->allocs->size; i++)
+    {
+        atomic_store_explicit(&((struct memory_segment *)arrayget(handler->allocs, i))->owner, NULL,
+                              memory_order_release);
+    }
+
+    /* freed segments are recycled once no transaction that could still reach them is running */
+    for (uint64_t i = 0; i < handler->frees->size; i++)
+    {
+        segment = arrayget(handler->frees, i);
+        if (segment_free(region, segment))
+        {
+            epoch_retire(region, handler, segment, segment_recycle);
+        }
+    }
+
+    trace_event(region, handler, TRACE_COMMIT, 0);
+    if (handler->is_ro && region->config.versions)
+    {
+        history_exit(region, handler);
+    }
+    cm_commit(region, handler);
+    epoch_exit(region, handler);
+    epoch_collect(region, handler);
+    handler_reset(handler);
+}
+
+void transaction_abort(region *region, handler *handler, abort_cause cause)
+{
+    stat_add(region->threads[handler->slot].stats.aborts[cause], 1);
+    trace_event(region, handler, TRACE_ABORT, cause);
+    if (region->profile && handler->conflict)
+    {
+        profile_record(region, handler, cause);
+    }
+
+    /* never published, so reusable by this thread right away */
+    for (uint64_t i = 0; i < handler->allocs->size; i++)
+    {
+        segment_uncommit(region, &region->threads[handler->slot], arrayget(handler->allocs, i));
+    }
+
+    if (handler->is_ro && region->config.versions)
+    {
+        history_exit(region, handler);
+    }
+    cm_abort(region, handler);
+    epoch_exit(region, handler);
+    epoch_collect(region, handler);
+    handler_reset(handler);
+}
+
+/* copy a logged run of words into its segment, splitting it only at interleaved block headers */
+static void write_back(region *region, write_entry *write)
+{
+    segment *segment;
+    void *word;
+    uint64_t span;
+
+    segment = region->segments[indexof(write->dest)];
+    if (region->config.vlocks != VLOCKS_INTERLEAVED)
+    {
+        memcpy(getword(region, segment, write->dest), write->src, write->size);
+        return;
+    }
+    for (uint64_t done = 0; done < write->size; done += span)
+    {
+        word = (char *)write->dest + done;
+        span = (region->config.block_words - wordindex(region, segment, word) % region->config.block_words) *
+               region->alignment;
+        span = span < write->size - done ? span : write->size - done;
+        memcpy(getword(region, segment, word), &write->src[done], span);
+    }
+}
+
+/** Copy between a private buffer and a segment owned by the running transaction, bypassing the logs and vlocks.
+ * @param store Whether to copy from private into the segment rather than out of it
+ **/
+void private_copy(region *region, segment *segment, void *opaque, void *private, size_t size, bool store)
+{
+    uint64_t n_words;
+    void *word, *offset_private;
+
+    n_words = size / region->alignment;
+    for (uint64_t i = 0; i < n_words; i++)
+    {
+        word = getword(region, segment, &((char *)opaque)[i * region->alignment]);
+        offset_private = &((char *)private)[i * region->alignment];
+        if (store)
+        {
+            memcpy(word, offset_private, region->alignment);
+        }
+        else
+        {
+            memcpy(offset_private, word, region->alignment);
+        }
+    }
 }
@@ -0,0 +1,219 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "trace.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "handler.h"
+#include "macros.h"
+#include "region.h"
+#include "stats.h"
+
+#ifdef TM_TRACE
+
+static inline uint64_t trace_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + (uint64_t)ts.tv_nsec;
+}
+
+/* cycle counter where the CPU has a cheap one, nanoseconds otherwise */
+static inline uint64_t trace_cycles(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __builtin_ia32_rdtsc();
+#else
+    return trace_ns();
+#endif
+}
+
+/** Record an event in the calling thread's ring, creating the ring on its first event.
+ * @param arg Event payload, see trace_type
+ **/
+void trace_emit(region *region, handler *handler, trace_type type, uint64_t arg)
+{
+    region_thread *thread = &region->threads[handler->slot];
+    trace_ring *ring = atomic_load_explicit(&thread->trace, memory_order_relaxed);
+    uint64_t head;
+
+    if (unlikely(!ring))
+    {
+        /* tracing is best effort, events are dropped while memory is short */
+        ring = malloc(sizeof(trace_ring));
+        if (unlikely(!ring))
+        {
+            return;
+        }
+        atomic_init(&ring->head, 0);
+        atomic_store_explicit(&thread->trace, ring, memory_order_release);
+    }
+    head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    ring->events[head & (TRACE_EVENTS - 1)] = (trace_event){trace_cycles(), type, arg};
+    atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+}
+
+void trace_start(region *region)
+{
+    char const *file = getenv("TM_TRACE_FILE");
+
+    region->trace.cycles = trace_cycles();
+    region->trace.ns = trace_ns();
+    region->trace.file = file && *file ? strdup(file) : NULL;
+}
+
+/* write the trace to TM_TRACE_FILE if set, then free the rings */
+void trace_stop(region *region)
+{
+    if (region->trace.file)
+    {
+        tm_trace_dump(region, region->trace.file);
+        free(region->trace.file);
+    }
+    for (uint64_t slot = 0; slot < handler_slots(); slot++)
+    {
+        free(atomic_load(&region->threads[slot].trace));
+    }
+}
+
+/* one Chrome trace event, args is the inside of a JSON object or NULL */
+static void trace_print(FILE *file, bool *first, char const *name, char phase, double us, uint64_t tid,
+                        char const *args)
+{
+    fprintf(file, "%s\n{\"ph\": \"%c\", \"pid\": 0, \"tid\": %lu, \"ts\": %.3f", *first ? "" : ",", phase, tid, us);
+    if (name)
+    {
+        fprintf(file, ", \"name\": \"%s\"", name);
+    }
+    if (phase == 'i')
+    {
+        fprintf(file, ", \"s\": \"t\"");
+    }
+    if (args)
+    {
+        fprintf(file, ", \"args\": {%s}", args);
+    }
+    fprintf(file, "}");
+    *first = false;
+}
+
+/* a thread's events, from its oldest transaction still whole in the ring */
+static void trace_print_ring(FILE *file, bool *first, region *region, uint64_t slot, trace_ring *ring,
+                             double us_per_cycle)
+{
+    uint64_t head, oldest;
+    trace_event event;
+    char args[64];
+    double us;
+    bool started = false, locked = false;
+
+    snprintf(args, sizeof(args), "\"name\": \"thread %lu\"", slot);
+    trace_print(file, first, "thread_name", 'M', 0, slot, args);
+
+    head = atomic_load_explicit(&ring->head, memory_order_acquire);
+    oldest = head > TRACE_EVENTS ? head - TRACE_EVENTS : 0;
+    for (uint64_t i = oldest; i < head; i++)
+    {
+        event = ring->events[i & (TRACE_EVENTS - 1)];
+        started = started || event.type == TRACE_BEGIN;
+        if (!started)
+        {
+            continue;
+        }
+        us = (int64_t)(event.cycles - region->trace.cycles) * us_per_cycle;
+        switch (event.type)
+        {
+        case TRACE_BEGIN:
+            trace_print(file, first, event.arg ? "read-only" : "update", 'B', us, slot, NULL);
+            break;
+        case TRACE_READ:
+        case TRACE_WRITE:
+            snprintf(args, sizeof(args), "\"words\": %lu", (uint64_t)event.arg);
+            trace_print(file, first, event.type == TRACE_READ ? "read" : "write", 'i', us, slot, args);
+            break;
+        case TRACE_VALIDATE:
+            trace_print(file, first, "validate", 'B', us, slot, NULL);
+            break;
+        case TRACE_LOCKED:
+            snprintf(args, sizeof(args), "\"vlocks\": %lu", (uint64_t)event.arg);
+            trace_print(file, first, "locked", 'B', us, slot, args);
+            locked = true;
+            break;
+        case TRACE_VALIDATED:
+            if (locked)
+            {
+                trace_print(file, first, NULL, 'E', us, slot, NULL);
+                locked = false;
+            }
+            snprintf(args, sizeof(args), "\"result\": \"%s\"", tm_abort_cause(event.arg));
+            trace_print(file, first, NULL, 'E', us, slot, args);
+            break;
+        case TRACE_COMMIT:
+            trace_print(file, first, NULL, 'E', us, slot, "\"end\": \"commit\"");
+            break;
+        case TRACE_ABORT:
+            snprintf(args, sizeof(args), "\"end\": \"abort\", \"cause\": \"%s\"", tm_abort_cause(event.arg));
+            trace_print(file, first, NULL, 'E', us, slot, args);
+            break;
+        }
+    }
+}
+
+#endif
+
+/** [thread-safe] Write the events of every thread as Chrome trace JSON, for chrome://tracing or Perfetto.
+ * Events written meanwhile may be torn, so the trace is exact only once transactions stop.
+ * @param shared Shared memory region
+ * @param path   File to create or overwrite
+ * @return Whether the trace was written, false in builds without TM_TRACE
+ **/
+bool tm_trace_dump(shared_t shared, char const *path)
+{
+#ifdef TM_TRACE
+    region *region = shared;
+    trace_ring *ring;
+    uint64_t cycles, ns;
+    double us_per_cycle;
+    bool first = true;
+    FILE *file;
+
+    file = fopen(path, "w");
+    if (unlikely(!file))
+    {
+        perror("fopen");
+        traceerror();
+        return false;
+    }
+
+    /* calibrate cycles against the time elapsed since tm_create */
+    cycles = trace_cycles() - region->trace.cycles;
+    ns = trace_ns() - region->trace.ns;
+    us_per_cycle = cycles ? (double)ns / cycles / 1000 : 0;
+
+    fprintf(file, "{\"displayTimeUnit\": \"ns\", \"traceEvents\": [");
+    for (uint64_t slot = 0; slot < handler_slots(); slot++)
+    {
+        ring = atomic_load_explicit(&region->threads[slot].trace, memory_order_acquire);
+        if (ring)
+        {
+            trace_print_ring(file, &first, region, slot, ring, us_per_cycle);
+        }
+    }
+    fprintf(file, "\n]}\n");
+    if (unlikely(fclose(file) != 0))
+    {
+        perror("fclose");
+        traceerror();
+        return false;
+    }
+    return true;
+#else
+    (void)shared;
+    (void)path;
+    fprintf(stderr, "tm_trace_dump: tracing is not compiled in, build with TRACE=1\n");
+    return false;
+#endif
+}
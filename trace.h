@@ -0,0 +1,66 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "tm.h"
+
+/* Event tracing, compiled in with -DTM_TRACE (make TRACE=1) and absent otherwise */
+
+#define TRACE_EVENTS 65536 /* per thread ring, power of 2, oldest events are overwritten */
+
+typedef enum trace_type
+{
+    TRACE_BEGIN,     /* arg: whether read-only */
+    TRACE_READ,      /* arg: words */
+    TRACE_WRITE,     /* arg: words */
+    TRACE_VALIDATE,  /* commit of an update transaction starts */
+    TRACE_LOCKED,    /* arg: vlocks acquired, held until TRACE_VALIDATED */
+    TRACE_VALIDATED, /* arg: abort_cause, ABORT_NONE once written back */
+    TRACE_COMMIT,
+    TRACE_ABORT, /* arg: abort_cause */
+} trace_type;
+
+typedef struct trace_event
+{
+    uint64_t cycles;
+    uint64_t type : 8;
+    uint64_t arg : 56;
+} trace_event;
+
+/* written by its thread only, readers load head before the events it covers */
+typedef struct trace_ring
+{
+    atomic_ulong head; /* events ever written */
+    trace_event events[TRACE_EVENTS];
+} trace_ring;
+
+/* reference point to convert cycle stamps to time */
+typedef struct trace_clock
+{
+    uint64_t cycles;
+    uint64_t ns;
+    char *file; /* TM_TRACE_FILE, written by tm_destroy, NULL if unset */
+} trace_clock;
+
+struct memory_region;
+struct transaction_handler;
+
+#ifdef TM_TRACE
+#define trace_event(region, handler, type, arg) trace_emit(region, handler, type, arg)
+#define trace_init(region) trace_start(region)
+#define trace_destroy(region) trace_stop(region)
+#else
+#define trace_event(region, handler, type, arg) ((void)0)
+#define trace_init(region) ((void)0)
+#define trace_destroy(region) ((void)0)
+#endif
+
+void trace_emit(struct memory_region *region, struct transaction_handler *handler, trace_type type, uint64_t arg);
+void trace_start(struct memory_region *region);
+void trace_stop(struct memory_region *region);
+bool tm_trace_dump(shared_t shared, char const *path);
+
+#endif
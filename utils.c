@@ -1,43 +1,86 @@
-#include "utils.h"
-#include <stdint.h>
-
-#include "sync.h"
-#include "macros.h"
-
-bool in_set(array *array, void *ptr)
-{
-    for (uint64_t i = 0; i < array->size; i++)
-    {
-        if (arrayget(array, i) == ptr)
-        {
-            return true;
-        }
-    }
-    return false;
-}
-
-bool release_vlocks(array *vlocks)
-{
-    bool err = true;
-    for (uint64_t i = 0; i < vlocks->size; i++)
-    {
-        if (!vlock_release(arrayget(vlocks, i)))
-        {
-            err = false;
-            traceerror();
-        }
-    }
-    return err;
-}
-
-write_entry *in_write_set(array *set, const char *addr)
-{
-    for (uint64_t i = 0; i < set->size; i++)
-    {
-        if (addr == ((write_entry *)arrayget(set, i))->dest)
-        {
-            return (write_entry *)arrayget(set, i);
-        }
-    }
-    return NULL;
-}
\ No newline at end of file
+#include "utils.h"
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "sync.h"
+#include "macros.h"
+
+static int vlock_cmp(const void *a, const void *b)
+{
+    uintptr_t x = (uintptr_t)(*(void *const *)a);
+    uintptr_t y = (uintptr_t)(*(void *const *)b);
+    return (x > y) - (x < y);
+}
+
+/* sort by address and drop duplicates */
+void sort_vlocks(array *vlocks)
+{
+    uint64_t n = 0;
+    if (vlocks->size < 2)
+    {
+        return;
+    }
+    qsort(vlocks->array, vlocks->size, sizeof(void *), vlock_cmp);
+    for (uint64_t i = 1; i < vlocks->size; i++)
+    {
+        if (arrayget(vlocks, i) != arrayget(vlocks, n))
+        {
+            arrayget(vlocks, ++n) = arrayget(vlocks, i);
+        }
+    }
+    vlocks->size = n + 1;
+}
+
+/* unlock the first n vlocks, leaving their versions untouched */
+bool release_vlocks(array *vlocks, uint64_t n)
+{
+    bool err = true;
+    for (uint64_t i = 0; i < n; i++)
+    {
+        if (!vlock_release(arrayget(vlocks, i)))
+        {
+            err = false;
+            traceerror();
+        }
+    }
+    return err;
+}
+
+void commit_vlocks(array *vlocks, uint64_t version)
+{
+    for (uint64_t i = 0; i < vlocks->size; i++)
+    {
+        atomic_store((vlock *)arrayget(vlocks, i), version);
+    }
+}
+
+/** Load n contiguous vlocks, up to the first that is locked or newer than a timestamp.
+ * An unlocked vlock holds its bare version, so one unsigned compare covers both cases.
+ * @param versions Receives the values loaded, to be compared by recheck_vlocks() after reading
+ * @return Index of the first such vlock, n if there is none
+ **/
+uint64_t snapshot_vlocks(vlock const *vlocks, uint64_t n, uint64_t timestamp, uint64_t *versions)
+{
+    for (uint64_t i = 0; i < n; i++)
+    {
+        versions[i] = atomic_load_explicit(&vlocks[i], memory_order_acquire);
+        if (versions[i] > timestamp)
+        {
+            return i;
+        }
+    }
+    return n;
+}
+
+/* index of the first of n contiguous vlocks that changed since snapshot_vlocks(), n if none did */
+uint64_t recheck_vlocks(vlock const *vlocks, uint64_t n, uint64_t const *versions)
+{
+    for (uint64_t i = 0; i < n; i++)
+    {
+        if (atomic_load_explicit(&vlocks[i], memory_order_relaxed) != versions[i])
+        {
+            return i;
+        }
+    }
+    return n;
+}
@@ -1,10 +1,14 @@
-#ifndef UTILS_H
-#define UTILS_H
-
-#include "array.h"
-#include "handler.h"
-bool in_set(array *array, void *ptr);
-bool release_vlocks(array *vlocks);
-write_entry *in_write_set(array *set, const char *addr);
-
-#endif
+#ifndef UTILS_H
+#define UTILS_H
+
+#include "array.h"
+#include "handler.h"
+#include "sync.h"
+
+void sort_vlocks(array *vlocks);
+bool release_vlocks(array *vlocks, uint64_t n);
+void commit_vlocks(array *vlocks, uint64_t version);
+uint64_t snapshot_vlocks(vlock const *vlocks, uint64_t n, uint64_t timestamp, uint64_t *versions);
+uint64_t recheck_vlocks(vlock const *vlocks, uint64_t n, uint64_t const *versions);
+
+#endif